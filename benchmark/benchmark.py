@@ -0,0 +1,358 @@
+import argparse
+import glob
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+
+# End-to-end benchmark of the firmware on BOARD=native: builds it with benchmark.ini, starts the gateway (or a stand-in)
+# with a fake Telegram endpoint on the host and drives sends over tap0. The results are written as JSON to
+# benchmark/results/<commit>.json, so they can be compared from commit to commit.
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(BENCH_DIR)
+SRC_DIR = os.path.join(REPO_DIR, "src")
+RESULTS_DIR = os.path.join(BENCH_DIR, "results")
+
+GATEWAY_ADDRESS = "2001:db8::1"
+NODE_ADDRESS = "2001:db8::2/64"
+TELEGRAM_PORT = 8081
+
+TOOK = re.compile(r"CoAP communication took (\d+) ms")
+PHASE = re.compile(r"^(\w+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)$")
+COUNTER = re.compile(r"^(\w+)\s+(\d+)$")
+ERROR = re.compile(r"^\s*(-?\d+)\s+(\d+)\s+(.*)$")
+IFACE = re.compile(r"Iface\s+(\d+)")
+
+# Unknown command whose error marks the end of the output of the previous command
+MARKER = "bench-end"
+
+
+def commit_hash():
+    return subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=REPO_DIR, capture_output=True,
+                          text=True).stdout.strip() or "unknown"
+
+
+def cpu_seconds(pid):
+    """User and system CPU time of a process in seconds, from /proc/<pid>/stat"""
+    with open(f"/proc/{pid}/stat") as f:
+        fields = f.read().rsplit(")", 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK")
+
+
+def percentile(values, percent):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, max(0, (len(values) * percent + 99) // 100 - 1))]
+
+
+class Firmware:
+    """Runs the native firmware and talks to its shell over stdin/stdout"""
+
+    def __init__(self, elf, tap, verbose):
+        self.process = subprocess.Popen([elf, tap], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        stderr=subprocess.STDOUT, text=True, bufsize=1)
+        self.lines = queue.Queue()
+        self.verbose = verbose
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        for line in self.process.stdout:
+            line = line.rstrip("\n")
+            if self.verbose:
+                print(f"  | {line}", file=sys.stderr)
+            # The shell echoes the prompt in front of the output
+            while line.startswith("> "):
+                line = line[2:]
+            self.lines.put(line)
+
+    def write(self, command):
+        self.process.stdin.write(command + "\n")
+        self.process.stdin.flush()
+
+    def expect(self, pattern, timeout):
+        """Waits for a line matching the pattern and returns the match"""
+        deadline = time.monotonic() + timeout
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise TimeoutError(f"No output matching '{pattern.pattern}' within {timeout} s")
+            try:
+                match = pattern.search(self.lines.get(timeout=remaining))
+            except queue.Empty:
+                continue
+            if match:
+                return match
+
+    def command(self, command, timeout=10):
+        """Runs a command and returns its output lines"""
+        self.drain()
+        self.write(command)
+        self.write(MARKER)
+        output = []
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            try:
+                line = self.lines.get(timeout=deadline - time.monotonic())
+            except queue.Empty:
+                break
+            if MARKER in line and line.strip() != MARKER:
+                return output
+            output.append(line)
+        raise TimeoutError(f"Command '{command}' did not finish within {timeout} s")
+
+    def drain(self):
+        """Drops the output received so far, returns the number of finished CoAP communications in it"""
+        took = 0
+        while True:
+            try:
+                took += bool(TOOK.search(self.lines.get_nowait()))
+            except queue.Empty:
+                return took
+
+    def stop(self):
+        self.process.terminate()
+        try:
+            self.process.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+
+
+def parse_stats(lines):
+    """Parses the output of the 'stats' shell command"""
+    stats = {"phases": {}, "counters": {}, "errors": {}}
+    section = "phases"
+    for line in lines:
+        if line.startswith("Phase"):
+            continue
+        if line.startswith("Code"):
+            section = "errors"
+            continue
+        if section == "errors":
+            match = ERROR.match(line)
+            if match:
+                stats["errors"][match.group(3)] = int(match.group(2))
+            continue
+        match = PHASE.match(line)
+        if match:
+            name, count, p50, p99, maximum = match.groups()
+            stats["phases"][name] = {"count": int(count), "p50_us": int(p50), "p99_us": int(p99),
+                                     "max_us": int(maximum)}
+            continue
+        match = COUNTER.match(line)
+        if match:
+            stats["counters"][match.group(1)] = int(match.group(2))
+    return stats
+
+
+def parse_power(lines):
+    """Parses the wake-up counters of the 'power' shell command"""
+    return {match.group(1): int(match.group(2)) for match in map(COUNTER.match, lines) if match}
+
+
+def build(config, board):
+    subprocess.run(["make", "-C", SRC_DIR, "all", f"BOARD={board}", f"CONFIG_INI={config}", "QUIET=1"], check=True)
+    elves = glob.glob(os.path.join(SRC_DIR, "bin", f"{board}*", "project-digitalization.elf"))
+    if not elves:
+        sys.exit(f"No firmware found in {SRC_DIR}/bin/{board}*")
+    return max(elves, key=os.path.getmtime)
+
+
+def start_gateway(kind, log):
+    """Starts the fake Telegram endpoint and the gateway, returns both processes"""
+    telegram = subprocess.Popen([sys.executable, os.path.join(BENCH_DIR, "fake_telegram.py"), str(TELEGRAM_PORT)],
+                                stdout=log, stderr=subprocess.STDOUT)
+    env = dict(os.environ, COAP_SERVER_IP=GATEWAY_ADDRESS)
+    if kind == "stub":
+        script = os.path.join(BENCH_DIR, "gateway_stub.py")
+    else:
+        script = os.path.join(REPO_DIR, "websocket", "coap_websocket.py")
+    gateway = subprocess.Popen([sys.executable, script], env=env, stdout=log, stderr=subprocess.STDOUT)
+    time.sleep(2)  # aiocoap binds the socket asynchronously
+    if gateway.poll() is not None:
+        sys.exit(f"The gateway exited with {gateway.returncode}, is {GATEWAY_ADDRESS} assigned to the tap interface?")
+    return telegram, gateway
+
+
+def telegram_calls():
+    try:
+        with urllib.request.urlopen(f"http://[::1]:{TELEGRAM_PORT}/stats", timeout=2) as response:
+            return json.load(response)
+    except OSError:
+        return {}
+
+
+def bring_up(firmware):
+    """Waits for the shell and assigns the node address, the firmware has no router on the tap interface"""
+    firmware.command("help", timeout=30)
+    output = firmware.command("ifconfig")
+    iface = next((m.group(1) for m in map(IFACE.search, output) if m), None)
+    if iface is None:
+        raise RuntimeError("No network interface found")
+    firmware.command(f"ifconfig {iface} add {NODE_ADDRESS}")
+
+
+def run_sends(firmware, count, timeout):
+    """Sends messages one after another from the shell, like the notifications but without sensor reading"""
+    firmware.command("stats reset")
+    latencies = []
+    start = time.monotonic()
+    for i in range(count):
+        firmware.drain()
+        sent = time.monotonic()
+        firmware.write(f"coap-send all bench{i}")
+        firmware.expect(TOOK, timeout)
+        latencies.append((time.monotonic() - sent) * 1000)
+    elapsed = time.monotonic() - start
+    stats = parse_stats(firmware.command("stats"))
+    return {
+        "messages": count,
+        "seconds": round(elapsed, 3),
+        "messages_per_second": round(count / elapsed, 2),
+        "host_latency_ms": {"p50": round(percentile(latencies, 50), 2), "p99": round(percentile(latencies, 99), 2),
+                            "max": round(max(latencies), 2)},
+        "bytes_per_request": round(stats["counters"].get("tx_bytes", 0) / max(1, stats["counters"].get("requests", 0)),
+                                   1),
+        "timeouts": stats["counters"].get("timeouts", 0),
+        "firmware": stats,
+    }
+
+
+def run_interval(firmware, duration):
+    """Lets the scheduler send on its shortened interval and counts the notifications"""
+    firmware.command("stats reset")
+    firmware.command("power reset")
+    firmware.command("scheduler start")
+    time.sleep(duration)
+    notifications = firmware.drain()
+    notifications += sum(bool(TOOK.search(line)) for line in firmware.command("scheduler stop"))
+    stats = parse_stats(firmware.command("stats"))
+    wakeups = parse_power(firmware.command("power"))
+    return {
+        "seconds": duration,
+        "notifications": notifications,
+        "notifications_per_second": round(notifications / duration, 2),
+        "bytes_per_notification": round(stats["counters"].get("tx_bytes", 0) / max(1, notifications), 1),
+        "wakeups_per_notification": round(wakeups.get("total", 0) / max(1, notifications), 2),
+        "wakeups": wakeups,
+        "firmware": stats,
+    }
+
+
+def compare(result, baseline_path, threshold):
+    """Prints the change of the main metrics against a baseline, returns False if one regressed beyond the threshold"""
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+
+    def metric(data, *path):
+        for key in path:
+            data = data.get(key, {}) if isinstance(data, dict) else {}
+        return data if isinstance(data, (int, float)) else None
+
+    # Metric path and whether a higher value is better
+    metrics = [
+        (("send", "messages_per_second"), True),
+        (("send", "host_latency_ms", "p50"), False),
+        (("send", "host_latency_ms", "p99"), False),
+        (("send", "firmware", "phases", "rtt", "p50_us"), False),
+        (("send", "firmware", "phases", "format", "p50_us"), False),
+        (("send", "firmware", "phases", "packet_build", "p50_us"), False),
+        (("send", "bytes_per_request"), False),
+        (("interval", "bytes_per_notification"), False),
+        (("interval", "wakeups_per_notification"), False),
+        (("cpu_seconds", "firmware"), False),
+        (("cpu_seconds", "gateway"), False),
+    ]
+    ok = True
+    print(f"Compared with {baseline.get('commit')}:")
+    for path, higher_is_better in metrics:
+        old, new = metric(baseline, *path), metric(result, *path)
+        if not old or new is None:
+            continue
+        change = (new - old) / old * 100
+        regressed = change < -threshold if higher_is_better else change > threshold
+        ok &= not regressed
+        print(f"  {'.'.join(path):45} {old:>10} -> {new:>10} ({change:+.1f} %){'  REGRESSION' if regressed else ''}")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end benchmark of the firmware on BOARD=native")
+    parser.add_argument("--gateway", choices=["websocket", "stub"], default="websocket",
+                        help="websocket/coap_websocket.py or the lightweight stand-in")
+    parser.add_argument("--tap", default="tap0", help="tap interface of the native board")
+    parser.add_argument("--board", default="native")
+    parser.add_argument("--messages", type=int, default=100, help="messages sent from the shell")
+    parser.add_argument("--duration", type=int, default=30, help="seconds of scheduled notifications")
+    parser.add_argument("--timeout", type=float, default=10, help="seconds to wait for a single send")
+    parser.add_argument("--config", default=os.path.join(BENCH_DIR, "benchmark.ini"))
+    parser.add_argument("--no-build", action="store_true", help="use the firmware built before")
+    parser.add_argument("--output", help="result file, benchmark/results/<commit>.json by default")
+    parser.add_argument("--compare", help="result file of a baseline")
+    parser.add_argument("--threshold", type=float, default=10, help="allowed regression in percent")
+    parser.add_argument("--verbose", action="store_true", help="print the firmware output")
+    args = parser.parse_args()
+
+    if args.no_build:
+        elves = glob.glob(os.path.join(SRC_DIR, "bin", f"{args.board}*", "project-digitalization.elf"))
+        if not elves:
+            sys.exit("No firmware built yet")
+        elf = max(elves, key=os.path.getmtime)
+    else:
+        elf = build(os.path.abspath(args.config), args.board)
+
+    os.makedirs(RESULTS_DIR, exist_ok=True)
+    with open(os.path.join(RESULTS_DIR, "gateway.log"), "w") as log:
+        telegram, gateway = start_gateway(args.gateway, log)
+        firmware = Firmware(elf, args.tap, args.verbose)
+        try:
+            bring_up(firmware)
+            firmware.command("scheduler stop")
+
+            # The first send registers the session, it is not measured
+            firmware.write("coap-send all warmup")
+            firmware.expect(TOOK, args.timeout)
+
+            cpu_start = cpu_seconds(firmware.process.pid), cpu_seconds(gateway.pid)
+            send = run_sends(firmware, args.messages, args.timeout)
+            interval = run_interval(firmware, args.duration)
+            cpu_end = cpu_seconds(firmware.process.pid), cpu_seconds(gateway.pid)
+        finally:
+            firmware.stop()
+            calls = telegram_calls()
+            for process in (gateway, telegram):
+                process.terminate()
+                process.wait()
+
+    result = {
+        "commit": commit_hash(),
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "gateway": args.gateway,
+        "board": args.board,
+        "send": send,
+        "interval": interval,
+        "cpu_seconds": {"firmware": round(cpu_end[0] - cpu_start[0], 2),
+                        "gateway": round(cpu_end[1] - cpu_start[1], 2)},
+        "telegram_calls": calls,
+    }
+
+    output = args.output or os.path.join(RESULTS_DIR, f"{result['commit']}.json")
+    with open(output, "w") as f:
+        json.dump(result, f, indent=2)
+    print(json.dumps({key: result[key] for key in ("commit", "cpu_seconds")}))
+    print(f"messages/s: {send['messages_per_second']}, host latency p50/p99: {send['host_latency_ms']['p50']}/"
+          f"{send['host_latency_ms']['p99']} ms, bytes/notification: {interval['bytes_per_notification']}")
+    print(f"Results written to {output}")
+
+    if args.compare and not compare(result, args.compare, args.threshold):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
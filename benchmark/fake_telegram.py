@@ -0,0 +1,44 @@
+import json
+import socket
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Fake Telegram Bot API for the gateway: every call succeeds and there are never updates.
+# GET /stats returns how often each method was called.
+calls = {}
+
+
+class Handler(BaseHTTPRequestHandler):
+    def _reply(self, body):
+        data = json.dumps(body).encode("utf-8")
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def _handle(self):
+        length = int(self.headers.get("Content-Length") or 0)
+        if length:
+            self.rfile.read(length)
+        if self.path == "/stats":
+            self._reply(calls)
+            return
+        method = self.path.rsplit("/", 1)[-1]
+        calls[method] = calls.get(method, 0) + 1
+        self._reply({"ok": True, "result": [] if method == "getUpdates" else {}})
+
+    do_GET = _handle
+    do_POST = _handle
+
+    def log_message(self, format, *args):
+        pass
+
+
+class Server(ThreadingHTTPServer):
+    address_family = socket.AF_INET6
+
+
+if __name__ == "__main__":
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8081
+    Server(("::1", port), Handler).serve_forever()
@@ -0,0 +1,47 @@
+import asyncio
+import os
+import secrets
+
+import aiocoap
+from aiocoap import resource, Code
+
+# Lightweight stand-in for websocket/coap_websocket.py: answers like the gateway without Telegram, so the benchmark
+# measures the firmware and the network only
+coap_server_ip = os.getenv("COAP_SERVER_IP", "::1")
+
+
+class Register(resource.Resource):
+    """Hands out a new session ID for every registration"""
+
+    async def render_post(self, request):
+        return aiocoap.Message(code=Code.CREATED, payload=f"sid={secrets.randbits(32):08x}".encode("utf-8"))
+
+
+class Message(resource.Resource):
+    """Accepts every message, block-wise requests are reassembled like in the gateway"""
+
+    async def needs_blockwise_assembly(self, request):
+        return True
+
+    async def render_post(self, request):
+        return aiocoap.Message(code=Code.CONTENT, payload=b"Messages sent successfully")
+
+
+class Update(resource.Resource):
+    """Never has configuration updates"""
+
+    async def render_post(self, request):
+        return aiocoap.Message(code=Code.VALID, payload=b"No Updates")
+
+
+async def main():
+    root = resource.Site()
+    root.add_resource(('register',), Register())
+    root.add_resource(('message',), Message())
+    root.add_resource(('update',), Update())
+    await aiocoap.Context.create_server_context(root, bind=(coap_server_ip, 5683))
+    await asyncio.get_running_loop().create_future()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,87 @@
+//
+// Created by vincent on 3/26/25.
+//
+
+#include "aggregate.h"
+#include "utils/error_handler.h"
+
+static aggregate_window_t windows[SENSORS_MAX_CHANNELS];
+
+// Divide by a power of ten with rounding half away from zero, e.g. 2515 (1 step) -> 252, -2515 -> -252
+static int64_t scale_down(int64_t value, int8_t steps) {
+    for (; steps > 0; steps--) {
+        value = (value + (value < 0 ? -5 : 5)) / 10;
+    }
+    return value;
+}
+
+// Divide with rounding half away from zero
+static int64_t divide_rounded(const int64_t sum, const uint32_t count) {
+    const int64_t half = count / 2;
+    return (sum + (sum < 0 ? -half : half)) / (int64_t)count;
+}
+
+void aggregate_add(const sensor_reading_t *reading) {
+    if (!reading || reading->channel >= SENSORS_MAX_CHANNELS) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return;
+    }
+
+    aggregate_window_t *window = &windows[reading->channel];
+    if (window->count == 0) {
+        *window = (aggregate_window_t){
+            .sum = reading->value, .count = 1, .min = reading->value, .max = reading->value,
+            .scale = reading->scale, .unit = reading->unit
+        };
+        return;
+    }
+
+    // Drivers may change the scale between readings (phydat_fit), the window keeps the coarser one
+    if (reading->scale > window->scale) {
+        const int8_t steps = reading->scale - window->scale;
+        window->sum = scale_down(window->sum, steps);
+        window->min = (int16_t)scale_down(window->min, steps);
+        window->max = (int16_t)scale_down(window->max, steps);
+        window->scale = reading->scale;
+    }
+    const int16_t value = (int16_t)scale_down(reading->value, window->scale - reading->scale);
+
+    window->sum += value;
+    window->count++;
+    if (value < window->min) {
+        window->min = value;
+    }
+    if (value > window->max) {
+        window->max = value;
+    }
+}
+
+bool aggregate_peek(const uint8_t channel, sensor_reading_t *summary) {
+    if (channel >= SENSORS_MAX_CHANNELS || windows[channel].count == 0) {
+        return false;
+    }
+
+    const aggregate_window_t *window = &windows[channel];
+    summary->value = (int16_t)divide_rounded(window->sum, window->count);
+    summary->min = window->min;
+    summary->max = window->max;
+    summary->count = window->count > UINT16_MAX ? UINT16_MAX : (uint16_t)window->count;
+    summary->scale = window->scale;
+    summary->unit = window->unit;
+    summary->channel = channel;
+    return true;
+}
+
+bool aggregate_take(const uint8_t channel, sensor_reading_t *summary) {
+    const bool available = aggregate_peek(channel, summary);
+    if (available) {
+        windows[channel].count = 0;
+    }
+    return available;
+}
+
+void aggregate_reset(void) {
+    for (uint8_t i = 0; i < SENSORS_MAX_CHANNELS; i++) {
+        windows[i].count = 0;
+    }
+}
@@ -0,0 +1,54 @@
+//
+// Created by vincent on 3/26/25.
+//
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+/**
+ * Running statistics of the readings of a channel since the last report, kept in integer fixed-point
+ */
+typedef struct {
+    int64_t sum;                                /**< Sum of the readings, in the scale of the window */
+    uint32_t count;                             /**< Number of readings */
+    int16_t min;                                /**< Smallest reading, in the scale of the window */
+    int16_t max;                                /**< Largest reading, in the scale of the window */
+    int8_t scale;                               /**< Coarsest scale of the readings (10^scale) */
+    uint8_t unit;                               /**< Unit of the readings */
+} aggregate_window_t;
+
+/**
+ * Add a reading to the window of its channel. If the reading has a coarser scale than the window, the window is
+ * converted to the scale of the reading, so mean, min and max always fit into the int16_t of phydat_t.
+ * @param reading Pointer to the reading.
+ */
+void aggregate_add(const sensor_reading_t *reading);
+
+/**
+ * Get the summary of the window of a channel without resetting it. The value of the summary is the rounded mean, its
+ * count is limited to UINT16_MAX.
+ * @param channel Index of the channel.
+ * @param summary Receives the summary, its timestamp is left unchanged.
+ * @return Whether the window contains any reading.
+ */
+bool aggregate_peek(uint8_t channel, sensor_reading_t *summary);
+
+/**
+ * Get the summary of the window of a channel, like aggregate_peek(), and start a new window.
+ * @param channel Index of the channel.
+ * @param summary Receives the summary, its timestamp is left unchanged.
+ * @return Whether the window contained any reading.
+ */
+bool aggregate_take(uint8_t channel, sensor_reading_t *summary);
+
+/**
+ * Discard the windows of every channel.
+ */
+void aggregate_reset(void);
+
+#endif //AGGREGATE_H
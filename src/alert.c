@@ -0,0 +1,190 @@
+//
+// Created by vincent on 3/30/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alert.h"
+#include "configuration.h"
+#include "coap_post.h"
+#include "lowpower.h"
+#include "utils/error_handler.h"
+
+#if ALERT_MAX_RULES > 8
+#error "ALERT_MAX_RULES is limited to 8, the rules of a channel are kept as bitmask!"
+#endif
+
+// Length of an alert message, e.g. "Alert: HDC1000[1] Temperature rising 2.50 °C/min (limit 1.00)"
+#define ALERT_MESSAGE_LENGTH 96
+
+/**
+ * Runtime state of the rules of a channel
+ */
+typedef struct {
+    int32_t last_value;                         /**< Previous reading in hundredths of a unit */
+    uint32_t last_time;                         /**< Time of the previous reading in milliseconds */
+    uint8_t rules;                              /**< Bitmask of the rules of the channel */
+    bool has_last;                              /**< Whether there is a previous reading */
+} alert_channel_t;
+
+static const char *kind_names[ALERT_KIND_COUNT] = { "above", "below", "rise", "fall" };
+
+static alert_channel_t channels[SENSORS_MAX_CHANNELS];
+static uint8_t active;                          // Rules which fired and did not fall back by the hysteresis yet
+static uint8_t pending;                         // Rules which fired and were not sent yet
+static int32_t fired_value[ALERT_MAX_RULES];    // Reading (or rate) which fired a rule
+static uint8_t fired_unit[ALERT_MAX_RULES];
+static volatile bool rules_changed = true;
+
+alert_kind_t alert_kind_parse(const char *name, const size_t len) {
+    for (int kind = 0; kind < ALERT_KIND_COUNT; kind++) {
+        if (strlen(kind_names[kind]) == len && memcmp(kind_names[kind], name, len) == 0) {
+            return kind;
+        }
+    }
+    return ALERT_KIND_COUNT;
+}
+
+const char *alert_kind_name(const alert_kind_t kind) {
+    return kind < ALERT_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+void alert_rules_changed(void) {
+    rules_changed = true;
+}
+
+// Rebuild the rule masks of the channels, runs in the CoAP thread, so the rules never change during an evaluation
+static void alert_apply_rules(void) {
+    rules_changed = false;
+    memset(channels, 0, sizeof(channels));
+    active = 0;
+    pending = 0;
+    const alert_rule_t *rules = config_get_alert_rules();
+    for (uint8_t i = 0; i < config_get_alert_rule_count(); i++) {
+        if (rules[i].channel < SENSORS_MAX_CHANNELS) {
+            channels[rules[i].channel].rules |= 1 << i;
+        }
+    }
+}
+
+// Fire a rule once its condition is met, and re-arm it once the value fell back by the hysteresis
+static void alert_update(const uint8_t rule, const bool fire, const bool clear, const int32_t value,
+                         const uint8_t unit) {
+    const uint8_t bit = 1 << rule;
+    if (fire && !(active & bit)) {
+        active |= bit;
+        pending |= bit;
+        fired_value[rule] = value;
+        fired_unit[rule] = unit;
+    } else if (clear) {
+        active &= ~bit;
+    }
+}
+
+void alert_check(const sensor_reading_t *reading) {
+    if (rules_changed) {
+        alert_apply_rules();
+    }
+    if (reading->channel >= SENSORS_MAX_CHANNELS || channels[reading->channel].rules == 0) {
+        return;  // The common case, a single lookup per reading
+    }
+
+    alert_channel_t *channel = &channels[reading->channel];
+    const int32_t value = sensors_hundredths(reading->value, reading->scale);
+    const int64_t delta = (int64_t)(value - channel->last_value) * 60000;
+    const uint32_t elapsed = reading->timestamp - channel->last_time;
+    const bool has_rate = channel->has_last && elapsed > 0;
+
+    const alert_rule_t *rules = config_get_alert_rules();
+    for (uint8_t i = 0; i < config_get_alert_rule_count(); i++) {
+        if (!(channel->rules & (1 << i))) {
+            continue;
+        }
+        const alert_rule_t *rule = &rules[i];
+        const int64_t limit = (int64_t)rule->limit * elapsed;           // Rates compared without a division
+        const int64_t rearm = (int64_t)(rule->limit - rule->hysteresis) * elapsed;
+        switch (rule->kind) {
+            case ALERT_ABOVE:
+                alert_update(i, value > rule->limit, value <= rule->limit - rule->hysteresis, value, reading->unit);
+                break;
+            case ALERT_BELOW:
+                alert_update(i, value < rule->limit, value >= rule->limit + rule->hysteresis, value, reading->unit);
+                break;
+            case ALERT_RISE:
+                if (has_rate) {
+                    alert_update(i, delta > limit, delta <= rearm, (int32_t)(delta / elapsed), reading->unit);
+                }
+                break;
+            case ALERT_FALL:
+                if (has_rate) {
+                    alert_update(i, -delta > limit, -delta <= rearm, (int32_t)(-delta / elapsed), reading->unit);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    channel->last_value = value;
+    channel->last_time = reading->timestamp;
+    channel->has_last = true;
+}
+
+// Write the message of a fired rule
+static void alert_format(const uint8_t rule_index, char *buf, const size_t size) {
+    const alert_rule_t *rule = &config_get_alert_rules()[rule_index];
+    char name[DEVICE_NAME_MAX_LEN];
+    char unit[SENSORS_UNIT_LENGTH];
+    char value[16];
+    char limit[16];
+    sensors_name(rule->channel, name, sizeof(name));
+    sensors_unit(fired_unit[rule_index], unit, sizeof(unit));
+    sensors_format_hundredths(fired_value[rule_index], value, sizeof(value));
+    sensors_format_hundredths(rule->limit, limit, sizeof(limit));
+
+    if (rule->kind == ALERT_RISE || rule->kind == ALERT_FALL) {
+        snprintf(buf, size, "Alert: %s %s %s %s %s/min (limit %s)", name, sensors_quantity(rule->channel),
+            rule->kind == ALERT_RISE ? "rising" : "falling", value, unit, limit);
+    } else {
+        snprintf(buf, size, "Alert: %s %s %s %s (%s %s)", name, sensors_quantity(rule->channel), value, unit,
+            alert_kind_name(rule->kind), limit);
+    }
+}
+
+void alert_send_pending(void) {
+    if (pending == 0) {
+        return;
+    }
+
+    char message[ALERT_MESSAGE_LENGTH];
+    lowpower_radio_wake(LOWPOWER_RADIO_COAP);
+    for (uint8_t i = 0; i < ALERT_MAX_RULES; i++) {
+        if (!(pending & (1 << i))) {
+            continue;
+        }
+        pending &= ~(1 << i);
+        alert_format(i, message, sizeof(message));
+        puts(message);
+
+        // A failed alert is not repeated, the reading still arrives with the next batch
+        int res = coap_post_send(message, "all");
+        if (res == COAP_SUCCESS) {
+            res = coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+        }
+        handle_error(__func__, res);
+    }
+    lowpower_radio_sleep(LOWPOWER_RADIO_COAP);
+}
+
+void alert_print(void) {
+    const alert_rule_t *rules = config_get_alert_rules();
+    char limit[16];
+    char hysteresis[16];
+    for (uint8_t i = 0; i < config_get_alert_rule_count(); i++) {
+        sensors_format_hundredths(rules[i].limit, limit, sizeof(limit));
+        sensors_format_hundredths(rules[i].hysteresis, hysteresis, sizeof(hysteresis));
+        printf("%-25s| channel %u %s %s%s, hysteresis %s\n", i == 0 ? "  Alert Rules" : "", rules[i].channel,
+            alert_kind_name(rules[i].kind), limit, rules[i].kind >= ALERT_RISE ? "/min" : "", hysteresis);
+    }
+}
@@ -0,0 +1,75 @@
+//
+// Created by vincent on 3/30/25.
+//
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_constants.h"
+#include "sensors.h"
+
+/**
+ * Condition of an alert rule
+ */
+typedef enum {
+    ALERT_ABOVE = 0,                            /**< Reading above the limit */
+    ALERT_BELOW,                                /**< Reading below the limit */
+    ALERT_RISE,                                 /**< Reading rises faster than the limit per minute */
+    ALERT_FALL,                                 /**< Reading falls faster than the limit per minute */
+    ALERT_KIND_COUNT
+} alert_kind_t;
+
+/**
+ * Alert rule of a channel, part of the configuration
+ */
+typedef struct {
+    int32_t limit;                              /**< Threshold in hundredths of a unit, or rate in hundredths per minute */
+    int32_t hysteresis;                         /**< Distance back from the limit before the rule fires again */
+    uint8_t channel;                            /**< Channel the rule applies to */
+    uint8_t kind;                               /**< Condition (alert_kind_t) */
+} alert_rule_t;
+
+/**
+ * Get the kind of a rule from its name ("above", "below", "rise", "fall").
+ * @param name The name, not necessarily terminated by '\0'.
+ * @param len Length of the name.
+ * @return The kind, or ALERT_KIND_COUNT for unknown names.
+ */
+alert_kind_t alert_kind_parse(const char *name, size_t len);
+
+/**
+ * Get the name of a kind.
+ * @param kind The kind.
+ * @return The name, e.g. "above".
+ */
+const char *alert_kind_name(alert_kind_t kind);
+
+/**
+ * Evaluate the rules of the channel of a reading, a rule which fires is sent by alert_send_pending(). Costs a single
+ * lookup for channels without rules.
+ * @param reading Pointer to the reading.
+ */
+void alert_check(const sensor_reading_t *reading);
+
+/**
+ * Send a message for every rule which fired since the last call to all chats right away, regardless of the interval
+ * and the batching of the samples. Has to be called from the CoAP thread.
+ */
+void alert_send_pending(void);
+
+/**
+ * Forget the state of the rules (fired rules, previous readings), called after the rules changed. The rules are
+ * applied with the next reading.
+ */
+void alert_rules_changed(void);
+
+/**
+ * Print the configured rules.
+ */
+void alert_print(void);
+
+#endif //ALERT_H
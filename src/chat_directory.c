@@ -0,0 +1,283 @@
+//
+// Created by vincent on 3/12/25.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chat_directory.h"
+#include "utils/error_handler.h"
+
+// Schedule of the chats without an entry in the schedule table
+static const chat_schedule_t batch_schedule = {
+    .interval = 0, .quiet_start = CHAT_QUIET_NONE, .quiet_end = CHAT_QUIET_NONE
+};
+
+// Get the offset of the name of a chat in the pool, the names are stored in the order of the IDs
+static uint16_t name_offset(const chat_directory_t *dir, const chat_index_t pos) {
+    uint16_t offset = 0;
+    for (chat_index_t i = 0; i < pos; i++) {
+        offset += strlen(&dir->name_pool[offset]) + 1;
+    }
+    return offset;
+}
+
+const char *chat_directory_name(const chat_directory_t *dir, const chat_index_t pos) {
+    return &dir->name_pool[name_offset(dir, pos)];
+}
+
+// Get the size of a name in the pool including its '\0', names are cut to CHAT_NAME_LENGTH like before
+static uint16_t name_size(const char *name) {
+    return strnlen(name, CHAT_NAME_LENGTH - 1) + 1;
+}
+
+// Binary search for the position of an ID, or the position where it has to be inserted
+static chat_index_t lower_bound_id(const chat_directory_t *dir, const int64_t id) {
+    chat_index_t low = 0;
+    chat_index_t high = dir->count;
+    while (low < high) {
+        const chat_index_t mid = low + (high - low) / 2;
+        if (dir->ids[mid] < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int chat_directory_find_id(const chat_directory_t *dir, const int64_t id) {
+    if (!dir) {
+        return -1;
+    }
+    const chat_index_t pos = lower_bound_id(dir, id);
+    return (pos < dir->count && dir->ids[pos] == id) ? pos : -1;
+}
+
+// Get the position of a chat by its name, -1 if the name is unknown or empty. Walks the pool once.
+static int find_name(const chat_directory_t *dir, const char *name) {
+    if (name[0] == '\0') {
+        return -1;
+    }
+    uint16_t offset = 0;
+    for (chat_index_t i = 0; i < dir->count; i++) {
+        const char *entry = &dir->name_pool[offset];
+        if (strncmp(entry, name, CHAT_NAME_LENGTH - 1) == 0) {
+            return i;
+        }
+        offset += strlen(entry) + 1;
+    }
+    return -1;
+}
+
+// Get the entry of a chat in the schedule table, -1 if the chat follows the batches
+static int find_schedule(const chat_directory_t *dir, const int64_t id) {
+    for (uint8_t i = 0; i < dir->schedule_count; i++) {
+        if (dir->schedules[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Release the entry of a chat in the schedule table, the last entry takes its place
+static void drop_schedule(chat_directory_t *dir, const int64_t id) {
+    const int entry = find_schedule(dir, id);
+    if (entry >= 0) {
+        dir->schedules[entry] = dir->schedules[--dir->schedule_count];
+    }
+}
+
+// Remove the chat at a position, the following chats and names move up to keep the arrays packed. Its schedule is
+// kept, it belongs to the ID.
+static void remove_entry(chat_directory_t *dir, const chat_index_t pos) {
+    const uint16_t offset = name_offset(dir, pos);
+    const uint16_t size = strlen(&dir->name_pool[offset]) + 1;
+    memmove(&dir->name_pool[offset], &dir->name_pool[offset + size], dir->pool_used - offset - size);
+    dir->pool_used -= size;
+
+    memmove(&dir->ids[pos], &dir->ids[pos + 1], (dir->count - pos - 1) * sizeof(dir->ids[0]));
+    dir->count--;
+}
+
+// Insert a chat at its sorted position, the caller has to make sure that there is enough space
+static void insert_entry(chat_directory_t *dir, const char *name, const int64_t id) {
+    const chat_index_t pos = lower_bound_id(dir, id);
+    memmove(&dir->ids[pos + 1], &dir->ids[pos], (dir->count - pos) * sizeof(dir->ids[0]));
+    dir->ids[pos] = id;
+
+    const uint16_t offset = name_offset(dir, pos);
+    const uint16_t size = name_size(name);
+    memmove(&dir->name_pool[offset + size], &dir->name_pool[offset], dir->pool_used - offset);
+    memcpy(&dir->name_pool[offset], name, size - 1);
+    dir->name_pool[offset + size - 1] = '\0';
+    dir->pool_used += size;
+    dir->count++;
+}
+
+void chat_directory_clear(chat_directory_t *dir) {
+    dir->count = 0;
+    dir->pool_used = 0;
+    dir->schedule_count = 0;
+    dir->revision++;
+}
+
+int chat_directory_set(chat_directory_t *dir, const char *name, const int64_t id) {
+    if (!dir || !name) {
+        handle_error(__func__, ERROR_NULL_POINTER);
+        return ERROR_NULL_POINTER;
+    }
+
+    const int by_id = chat_directory_find_id(dir, id);
+    const int by_name = find_name(dir, name);
+    if (by_id >= 0 && by_id == by_name) {
+        return CONFIG_SUCCESS;  // Unchanged
+    }
+
+    // Check the space first, the replaced chats free their slots and names
+    chat_index_t count = dir->count;
+    uint16_t pool_used = dir->pool_used;
+    if (by_id >= 0) {
+        count--;
+        pool_used -= name_size(chat_directory_name(dir, by_id));
+    }
+    if (by_name >= 0 && by_name != by_id) {
+        count--;
+        pool_used -= name_size(name);
+    }
+    if (count >= MAX_CHAT_IDS || pool_used + name_size(name) > CHAT_NAME_POOL_SIZE) {
+        handle_error(__func__, ERROR_CHAT_DIRECTORY_FULL);
+        return ERROR_CHAT_DIRECTORY_FULL;
+    }
+
+    // Replace the chat with the same name or ID, the positions change after the first removal. A new chat follows the
+    // batches, a renamed chat keeps its schedule.
+    if (by_name >= 0) {
+        if (by_name != by_id) {
+            drop_schedule(dir, dir->ids[by_name]);
+        }
+        remove_entry(dir, by_name);
+    }
+    const int old = chat_directory_find_id(dir, id);
+    if (old >= 0) {
+        remove_entry(dir, old);
+    }
+    insert_entry(dir, name, id);
+    dir->revision++;
+    return CONFIG_SUCCESS;
+}
+
+int chat_directory_find(const chat_directory_t *dir, const char *id_or_name) {
+    if (!dir || !id_or_name) {
+        return -1;
+    }
+    int pos = find_name(dir, id_or_name);
+    int64_t id;
+    if (pos < 0 && chat_directory_parse_id(id_or_name, &id)) {
+        pos = chat_directory_find_id(dir, id);
+    }
+    return pos;
+}
+
+bool chat_directory_remove(chat_directory_t *dir, const char *id_or_name) {
+    if (!dir || !id_or_name) {
+        handle_error(__func__, ERROR_NULL_POINTER);
+        return false;
+    }
+
+    const int pos = chat_directory_find(dir, id_or_name);
+    if (pos < 0) {
+        return false;
+    }
+    drop_schedule(dir, dir->ids[pos]);
+    remove_entry(dir, pos);
+    dir->revision++;
+    return true;
+}
+
+int chat_directory_set_schedule(chat_directory_t *dir, const char *id_or_name, const chat_schedule_t *schedule) {
+    if (!dir || !id_or_name || !schedule) {
+        handle_error(__func__, ERROR_NULL_POINTER);
+        return ERROR_NULL_POINTER;
+    }
+
+    // The schedule is not part of the chat list of the websocket session, the revision stays
+    const int pos = chat_directory_find(dir, id_or_name);
+    if (pos < 0) {
+        handle_error(__func__, ERROR_CHAT_ID_NOT_FOUND);
+        return ERROR_CHAT_ID_NOT_FOUND;
+    }
+    const int64_t id = dir->ids[pos];
+    int entry = find_schedule(dir, id);
+
+    // A chat which just follows the batches does not need an entry
+    if (schedule->interval == 0 && !chat_schedule_has_quiet(schedule)) {
+        drop_schedule(dir, id);
+        return CONFIG_SUCCESS;
+    }
+    if (entry < 0) {
+        if (dir->schedule_count >= MAX_SCHEDULED_CHATS) {
+            handle_error(__func__, ERROR_CHAT_SCHEDULE_FULL);
+            return ERROR_CHAT_SCHEDULE_FULL;
+        }
+        entry = dir->schedule_count++;
+        dir->schedules[entry].id = id;
+    }
+    dir->schedules[entry].schedule = *schedule;
+    return CONFIG_SUCCESS;
+}
+
+const chat_schedule_t *chat_directory_schedule(const chat_directory_t *dir, const chat_index_t pos) {
+    const int entry = find_schedule(dir, dir->ids[pos]);
+    return entry < 0 ? &batch_schedule : &dir->schedules[entry].schedule;
+}
+
+bool chat_schedule_has_quiet(const chat_schedule_t *schedule) {
+    return schedule->quiet_start != CHAT_QUIET_NONE && schedule->quiet_end != CHAT_QUIET_NONE
+        && schedule->quiet_start != schedule->quiet_end;
+}
+
+bool chat_schedule_quiet(const chat_schedule_t *schedule, const uint16_t minute) {
+    if (!chat_schedule_has_quiet(schedule)) {
+        return false;
+    }
+    const uint16_t start = schedule->quiet_start;
+    const uint16_t end = schedule->quiet_end;
+    return start < end ? (minute >= start && minute < end) : (minute >= start || minute < end);
+}
+
+const int64_t *chat_directory_find_by_name(const chat_directory_t *dir, const char *name) {
+    if (!dir || !name) {
+        return NULL;
+    }
+    const int pos = find_name(dir, name);
+    return pos < 0 ? NULL : &dir->ids[pos];
+}
+
+void chat_set_add(chat_set_t *set, const chat_index_t pos) {
+    set->bits[pos / 32] |= 1UL << (pos % 32);
+}
+
+bool chat_set_contains(const chat_set_t *set, const chat_index_t pos) {
+    return (set->bits[pos / 32] >> (pos % 32)) & 1;
+}
+
+chat_index_t chat_set_count(const chat_set_t *set) {
+    chat_index_t count = 0;
+    for (size_t i = 0; i < sizeof(set->bits) / sizeof(set->bits[0]); i++) {
+        for (uint32_t bits = set->bits[i]; bits; bits &= bits - 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool chat_directory_parse_id(const char *str, int64_t *id) {
+    char *end;
+    const long long value = strtoll(str, &end, 10);
+    if (end == str || *end != '\0') {
+        return false;
+    }
+    *id = value;
+    return true;
+}
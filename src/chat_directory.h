@@ -0,0 +1,186 @@
+//
+// Created by vincent on 3/12/25.
+//
+
+#ifndef CHAT_DIRECTORY_H
+#define CHAT_DIRECTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_constants.h"
+
+/**
+ * Position of a chat in the directory
+ */
+typedef uint16_t chat_index_t;
+
+/**
+ * Minutes of the day of a quiet window which is never reached, i.e. the chat has no quiet window
+ */
+#define CHAT_QUIET_NONE UINT16_MAX
+
+/**
+ * Notification schedule of a chat
+ */
+typedef struct {
+    uint16_t interval;                              /**< Minutes between two notifications, 0 = with the batches */
+    uint16_t quiet_start;                           /**< Start of the quiet window in minutes of the day */
+    uint16_t quiet_end;                             /**< End of the quiet window in minutes of the day (excluded) */
+} chat_schedule_t;
+
+/**
+ * Set of chats by their positions in the directory, a recipient list of MAX_CHAT_IDS bits instead of a copy of the IDs.
+ * A set is only valid until the directory changes.
+ */
+typedef struct {
+    uint32_t bits[(MAX_CHAT_IDS + 31) / 32];        /**< Bit i is set if the chat at position i is in the set */
+} chat_set_t;
+
+/**
+ * Schedule of a chat which does not just follow the batches
+ */
+typedef struct {
+    int64_t id;                                     /**< Chat the schedule belongs to */
+    chat_schedule_t schedule;                       /**< Notification schedule of the chat */
+} chat_schedule_entry_t;
+
+/**
+ * Packed directory of the telegram chats.
+ * The chat IDs are stored as integers sorted in ascending order, so the ID array doubles as the recipient list of a
+ * notification. The names are stored back to back in a shared pool in the order of the IDs, names are only looked up
+ * by the shell and the configuration commands, so they are searched linearly. Only the chats with a schedule of their
+ * own take an entry of the schedule table.
+ */
+typedef struct {
+    int64_t ids[MAX_CHAT_IDS];                      /**< Chat IDs, sorted in ascending order */
+    chat_schedule_entry_t schedules[MAX_SCHEDULED_CHATS];   /**< Schedules of the chats, in no particular order */
+    char name_pool[CHAT_NAME_POOL_SIZE];            /**< Name of each chat in the order of the IDs, '\0' terminated */
+    uint16_t pool_used;                             /**< Number of bytes used in the name pool */
+    chat_index_t count;                             /**< Number of chats */
+    uint16_t revision;                              /**< Changes whenever a chat is added, updated or removed */
+    uint8_t schedule_count;                         /**< Number of entries in the schedule table */
+} chat_directory_t;
+
+/**
+ * Remove all chats from the directory.
+ * @param dir Pointer to the directory.
+ */
+void chat_directory_clear(chat_directory_t *dir);
+
+/**
+ * Add a chat or update an existing one. An existing chat with the same name or the same ID is replaced, so names and
+ * IDs stay unique.
+ * @param dir Pointer to the directory.
+ * @param name Name of the chat, may be empty.
+ * @param id ID of the chat.
+ * @return Custom codes defined in error_handler.h.
+ */
+int chat_directory_set(chat_directory_t *dir, const char *name, int64_t id);
+
+/**
+ * Remove a chat by its name or its ID.
+ * @param dir Pointer to the directory.
+ * @param id_or_name Name of the chat or its ID as decimal string.
+ * @return Whether a chat was removed.
+ */
+bool chat_directory_remove(chat_directory_t *dir, const char *id_or_name);
+
+/**
+ * Change the notification schedule of a chat, the schedule stays with the chat when its name changes. A schedule which
+ * follows the batches without a quiet window releases the entry of the chat.
+ * @param dir Pointer to the directory.
+ * @param id_or_name Name of the chat or its ID as decimal string.
+ * @param schedule The new schedule.
+ * @return CONFIG_SUCCESS, ERROR_CHAT_ID_NOT_FOUND if there is no such chat or ERROR_CHAT_SCHEDULE_FULL if
+ *         MAX_SCHEDULED_CHATS chats have a schedule already.
+ */
+int chat_directory_set_schedule(chat_directory_t *dir, const char *id_or_name, const chat_schedule_t *schedule);
+
+/**
+ * Get the notification schedule of the chat at a position.
+ * @param dir Pointer to the directory.
+ * @param pos Position of the chat, has to be smaller than the number of chats.
+ * @return Pointer to the schedule, chats without an entry share a schedule which follows the batches.
+ */
+const chat_schedule_t *chat_directory_schedule(const chat_directory_t *dir, chat_index_t pos);
+
+/**
+ * Find the ID of a chat by its name, in O(n).
+ * @param dir Pointer to the directory.
+ * @param name Name of the chat.
+ * @return Pointer to the ID (a recipient list with a single entry) or NULL if there is no chat with this name.
+ *         The pointer is valid until the directory changes.
+ */
+const int64_t *chat_directory_find_by_name(const chat_directory_t *dir, const char *name);
+
+/**
+ * Find the position of a chat by its ID, in O(log n).
+ * @param dir Pointer to the directory.
+ * @param id ID of the chat.
+ * @return Position of the chat or -1 if there is no chat with this ID.
+ */
+int chat_directory_find_id(const chat_directory_t *dir, int64_t id);
+
+/**
+ * Find the position of a chat by its name or its ID. Names are checked first (O(n)), then the ID (O(log n)).
+ * @param dir Pointer to the directory.
+ * @param id_or_name Name of the chat or its ID as decimal string.
+ * @return Position of the chat or -1 if there is no such chat.
+ */
+int chat_directory_find(const chat_directory_t *dir, const char *id_or_name);
+
+/**
+ * Get the name of the chat at a position, the names in front of it are skipped in O(n).
+ * @param dir Pointer to the directory.
+ * @param pos Position of the chat, has to be smaller than the number of chats.
+ * @return Name of the chat, empty if the chat has no name.
+ */
+const char *chat_directory_name(const chat_directory_t *dir, chat_index_t pos);
+
+/**
+ * Check if a schedule has a quiet window.
+ * @param schedule Pointer to the schedule.
+ * @return Whether the schedule has a quiet window of at least one minute.
+ */
+bool chat_schedule_has_quiet(const chat_schedule_t *schedule);
+
+/**
+ * Check if a minute of the day is inside the quiet window of a schedule.
+ * @param schedule Pointer to the schedule.
+ * @param minute Minute of the day (0 to 1439).
+ * @return Whether the chat is quiet, windows across midnight (e.g. 22:00 to 7:00) are supported.
+ */
+bool chat_schedule_quiet(const chat_schedule_t *schedule, uint16_t minute);
+
+/**
+ * Add a chat to a set.
+ * @param set Pointer to the set.
+ * @param pos Position of the chat.
+ */
+void chat_set_add(chat_set_t *set, chat_index_t pos);
+
+/**
+ * Check if a chat is in a set.
+ * @param set Pointer to the set.
+ * @param pos Position of the chat.
+ * @return Whether the chat is in the set.
+ */
+bool chat_set_contains(const chat_set_t *set, chat_index_t pos);
+
+/**
+ * Count the chats in a set.
+ * @param set Pointer to the set.
+ * @return Number of chats in the set.
+ */
+chat_index_t chat_set_count(const chat_set_t *set);
+
+/**
+ * Parse a chat ID, telegram uses negative IDs for groups.
+ * @param str Decimal string.
+ * @param id Pointer where the ID is stored.
+ * @return Whether the string is a valid ID.
+ */
+bool chat_directory_parse_id(const char *str, int64_t *id);
+
+#endif //CHAT_DIRECTORY_H
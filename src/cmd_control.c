@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "shell.h"
 #include "ztimer.h"
@@ -13,6 +14,43 @@
 #include "utils/error_handler.h"
 #include "coap_post.h"
 #include "configuration.h"
+#include "config_store.h"
+#include "scheduler.h"
+#include "outbox.h"
+#include "startup.h"
+#include "mem_report.h"
+#include "stats.h"
+#include "sensors.h"
+#include "lowpower.h"
+#include "recipients.h"
+
+// Parse a time of day "HH:MM" into minutes of the day
+static bool parse_time(const char *str, uint16_t *minute) {
+    unsigned hours, minutes;
+    char end;
+    if (sscanf(str, "%u:%u%c", &hours, &minutes, &end) != 2 || hours > 23 || minutes > 59) {
+        return false;
+    }
+    *minute = hours * 60 + minutes;
+    return true;
+}
+
+// Parse a quiet window "HH:MM-HH:MM", "off" removes it
+static bool parse_quiet(const char *str, chat_schedule_t *schedule) {
+    schedule->quiet_start = CHAT_QUIET_NONE;
+    schedule->quiet_end = CHAT_QUIET_NONE;
+    if (strcmp(str, "off") == 0) {
+        return true;
+    }
+    char start[6];
+    const char *dash = strchr(str, '-');
+    if (!dash || dash - str >= (int)sizeof(start)) {
+        return false;
+    }
+    memcpy(start, str, dash - str);
+    start[dash - str] = '\0';
+    return parse_time(start, &schedule->quiet_start) && parse_time(dash + 1, &schedule->quiet_end);
+}
 
 // Handle LED control commands
 static int led_control(const int argc, char **argv) {
@@ -42,6 +80,12 @@ static int cpu_temp_control(const int argc, char **argv) {
     cpu_temperature_formatter(&temp, CALL_FROM_CLASS_CMD, buffer_temp, CLASS_CMD_BUFFER_SIZE);
     puts(buffer_temp);
 
+    // Statistics of the readings since the last report, while oversampling
+    if (SAMPLE_SUBINTERVAL > 0 && cpu_temperature_window(&temp)) {
+        cpu_temperature_formatter(&temp, CALL_FROM_CLASS_AGGREGATE, buffer_temp, CLASS_CMD_BUFFER_SIZE);
+        puts(buffer_temp);
+    }
+
     return TEMP_SUCCESS;
 }
 
@@ -55,6 +99,8 @@ static int coap_send_control(const int argc, char **argv) {
     }
     const uint32_t start_time = ztimer_now(ZTIMER_MSEC);
 
+    // In low-power mode the radio sleeps between the reports, it sleeps again once the response arrived
+    lowpower_radio_wake(LOWPOWER_RADIO_SHELL);
     const int res = coap_post_send(argv[2], argv[1]);
     handle_error(__func__, res);
 
@@ -62,15 +108,9 @@ static int coap_send_control(const int argc, char **argv) {
         if (app_config.enable_led_feedback) {
             led_control_execute(0, "on");
         }
-
-        uint32_t wait_time = 1000;  // Max wait time
-        while (!get_coap_response_status() && wait_time > 0) {
-            printf("CoAP handler status: %s\n", get_coap_response_status() == 0 ? "Running" : "Finished");
-            ztimer_sleep(ZTIMER_MSEC, 50);
-            wait_time -= 50;
-        }
-        printf("CoAP handler status: %s\n", get_coap_response_status() == 0 ? "Running" : "Finished");
+        handle_error(__func__, coap_post_wait_response(COAP_RESPONSE_TIMEOUT));
     }
+    lowpower_radio_sleep(LOWPOWER_RADIO_SHELL);
     const uint32_t elapsed_time = ztimer_now(ZTIMER_MSEC) - start_time;  // Compute elapsed time
     printf("CoAP communication took %lu ms to finish.\n", (unsigned long)elapsed_time);
 
@@ -91,6 +131,7 @@ static int coap_get_updates_control(const int argc, char **argv) {
     (void) argv;
     const uint32_t start_time = ztimer_now(ZTIMER_MSEC);
 
+    lowpower_radio_wake(LOWPOWER_RADIO_SHELL);
     const int res = coap_post_get_updates();
     handle_error(__func__, res);
 
@@ -98,18 +139,9 @@ static int coap_get_updates_control(const int argc, char **argv) {
         if (app_config.enable_led_feedback) {
             led_control_execute(0, "on");
         }
-
-        uint32_t wait_time = 1000;  // Max wait time
-        while (!get_coap_response_status() && wait_time > 0) {
-            printf("CoAP handler status: %s\n", get_coap_response_status() == 0 ? "Running" : "Finished");
-            ztimer_sleep(ZTIMER_MSEC, 50);
-            wait_time -= 50;
-        }
-
-        //config_control();
-
-        printf("CoAP handler status: %s\n", get_coap_response_status() == 0 ? "Running" : "Finished");
+        handle_error(__func__, coap_post_wait_response(COAP_RESPONSE_TIMEOUT));
     }
+    lowpower_radio_sleep(LOWPOWER_RADIO_SHELL);
     const uint32_t elapsed_time = ztimer_now(ZTIMER_MSEC) - start_time;  // Compute elapsed time
     printf("CoAP communication took %lu ms to finish.\n", (unsigned long)elapsed_time);
 
@@ -122,7 +154,8 @@ static int coap_get_updates_control(const int argc, char **argv) {
 
 // Change Configuration during runtime
 static int modify_config(const int argc, char **argv) {
-    if (argc < 2 || argc > 4) {
+    // Only alert rules take up to four values
+    if (argc < 2 || argc > (strcmp(argv[1], "alert") == 0 ? 6 : 4)) {
         handle_error(__func__,ERROR_INVALID_ARGUMENT);
         return ERROR_INVALID_ARGUMENT;
     }
@@ -135,28 +168,53 @@ static int modify_config(const int argc, char **argv) {
         puts("Usage:");
         puts("  config help                         (Print this message)");
         puts("  config show                         (Show the current configuration)");
+        puts("  config reset                        (Erase the stored configuration, defaults apply after reboot)");
         puts("  config interval <minutes>           (Set temperature notification interval)");
         puts("  config feedback <0|1>               (Enable/disable LED feedback)");
+        puts("  config batch <samples>              (Set number of samples sent in one notification)");
+        puts("  config max-age <minutes>            (Set maximum age of a sample before sending)");
+        puts("  config deadband <hundredths>        (Report only changes larger than this, 0 = always)");
+        puts("  config heartbeat <intervals>        (Always report after this many intervals, 0 = never)");
+        puts("  config alert <channel> <above|below|rise|fall> <hundredths|off> [hysteresis]");
+        puts("                                      (Alert right away on a threshold or a change per minute)");
+        puts("  config encoding <text|cbor>         (Set encoding of the CoAP requests)");
         puts("  config bot-token <token>            (Set Telegram bot token)");
         puts("  config set-chat <name> <id>         (Create a new name-ID pair or update an existing one)");
         puts("  config remove-chat <id_or_name>     (Remove a chat entry by ID or name)");
+        puts("  config schedule <id_or_name> <minutes> [HH:MM-HH:MM|off]");
+        puts("                                      (Own interval of a chat, 0 = with the batches, and quiet window)");
+        puts("  config clock <HH:MM>                (Set the time of day of the quiet windows)");
         puts("  config telegram-url <url>           (Set Telegram bot API URL)");
         puts("  config address <IPv6>               (Set CoAP server address)");
         puts("  config port <port>                  (Set CoAP server port)");
         puts("  config uri-path <path>              (Set CoAP server URI path)");
     }
+    else if (strcmp(name, "reset") == 0) {
+        if (config_store_erase() == CONFIG_SUCCESS) {
+            puts("Stored configuration erased, reboot to apply the defaults.");
+        }
+    }
     else if (strcmp(name, "show") == 0) {
         puts("============================================================");
         puts("Current Configuration:");
         puts("------------------------------------------------------------");
         printf("%-25s| %d\n", "  Notification Interval", config_get_notification_interval());
         printf("%-25s| %s\n", "  LED Feedback", config_get_led_feedback() ? "Enabled" : "Disabled");
+        printf("%-25s| %d\n", "  Sample Batch Size", config_get_sample_batch_size());
+        printf("%-25s| %d\n", "  Sample Max Age", config_get_sample_max_age());
+        printf("%-25s| %d\n", "  Report Deadband", config_get_report_deadband());
+        printf("%-25s| %d\n", "  Report Heartbeat", config_get_report_heartbeat());
+        printf("%-25s| %s\n", "  Request Encoding", config_get_request_encoding() == REQUEST_ENCODING_CBOR ? "CBOR" : "Text");
         printf("%-25s| %s\n", "  Telegram Bot Token", "[HIDDEN]");  // Not really necessary
         printf("%-25s| %s\n", "  Telegram URL", config_get_telegram_url());
         printf("%-25s| %s\n", "  CoAP Server Address", config_get_address());
         printf("%-25s| %s\n", "  CoAP Server Port", config_get_port());
         printf("%-25s| %s\n", "  CoAP URI Path", config_get_uri_path());
-        printf("%-25s| %s\n", "  Chat IDs", config_get_chat_ids_string());
+        printf("%-25s| %u\n", "  Chat IDs", config_get_chat_count());
+        for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+            printf("%-25s| %s:%lld\n", "", config_get_chat_name(i), (long long)config_get_chat_ids()[i]);
+        }
+        alert_print();
         puts("============================================================");
         puts("");
     }
@@ -166,7 +224,9 @@ static int modify_config(const int argc, char **argv) {
             handle_error(__func__, ERROR_INVALID_ARG_INTERVAL);
             return ERROR_INVALID_ARGUMENT;
         }
-        config_set_notification_interval(interval);
+        if (config_set_notification_interval(interval) != CONFIG_SUCCESS) {
+            return ERROR_INVALID_ARGUMENT;
+        }
         puts("Temperature notification interval set successful.");
     }
     else if (strcmp(name, "feedback") == 0 || strcmp(name, "led-feedback") == 0) {
@@ -178,6 +238,79 @@ static int modify_config(const int argc, char **argv) {
         config_set_led_feedback(feedback);
         puts("LED feedback set successful.");
     }
+    else if (strcmp(name, "batch") == 0) {
+        const int size = atoi(value);
+        if (size <= 0 || size > SAMPLE_BUFFER_SIZE) {
+            handle_error(__func__, ERROR_INVALID_ARG_BATCH);
+            return ERROR_INVALID_ARG_BATCH;
+        }
+        config_set_sample_batch_size(size);
+        puts("Sample batch size set successful.");
+    }
+    else if (strcmp(name, "max-age") == 0) {
+        const int age = atoi(value);
+        if (age <= 0) {
+            handle_error(__func__, ERROR_INVALID_ARG_INTERVAL);
+            return ERROR_INVALID_ARG_INTERVAL;
+        }
+        if (config_set_sample_max_age(age) != CONFIG_SUCCESS) {
+            return ERROR_INVALID_ARG_INTERVAL;
+        }
+        puts("Sample max age set successful.");
+    }
+    else if (strcmp(name, "deadband") == 0) {
+        if (argc != 3 || atoi(value) < 0) {
+            puts("Usage: config deadband <hundredths>");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        if (config_set_report_deadband(atoi(value)) != CONFIG_SUCCESS) {
+            return ERROR_INVALID_ARGUMENT;
+        }
+        puts("Report deadband set successful.");
+    }
+    else if (strcmp(name, "heartbeat") == 0) {
+        if (argc != 3 || atoi(value) < 0) {
+            puts("Usage: config heartbeat <intervals>");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        if (config_set_report_heartbeat(atoi(value)) != CONFIG_SUCCESS) {
+            return ERROR_INVALID_ARGUMENT;
+        }
+        puts("Report heartbeat set successful.");
+    }
+    else if (strcmp(name, "alert") == 0) {
+        const alert_kind_t kind = argc >= 5 ? alert_kind_parse(argv[3], strlen(argv[3])) : ALERT_KIND_COUNT;
+        if (kind == ALERT_KIND_COUNT || (strcmp(argv[4], "off") == 0 && argc != 5)) {
+            puts("Usage: config alert <channel> <above|below|rise|fall> <hundredths|off> [hysteresis]");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        int alert_res;
+        if (strcmp(argv[4], "off") == 0) {
+            alert_res = config_remove_alert_rule(atoi(value), kind);
+        } else {
+            const alert_rule_t rule = {
+                .limit = atoi(argv[4]), .hysteresis = argc == 6 ? atoi(argv[5]) : 0,
+                .channel = atoi(value), .kind = kind
+            };
+            alert_res = config_set_alert_rule(&rule);
+        }
+        if (alert_res != CONFIG_SUCCESS) {
+            return alert_res;
+        }
+        puts("Alert rule set successful.");
+    }
+    else if (strcmp(name, "encoding") == 0) {
+        if (argc != 3 || (strcmp(value, "text") != 0 && strcmp(value, "cbor") != 0)) {
+            puts("Usage: config encoding <text|cbor>");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        config_set_request_encoding(strcmp(value, "cbor") == 0 ? REQUEST_ENCODING_CBOR : REQUEST_ENCODING_TEXT);
+        puts("Request encoding set successful.");
+    }
     else if (strcmp(name, "bot-token") == 0) {
         config_set_bot_token(value);
         puts("Bot token updated successful.");
@@ -188,7 +321,10 @@ static int modify_config(const int argc, char **argv) {
             handle_error(__func__,ERROR_INVALID_ARGUMENT);
             return ERROR_INVALID_ARGUMENT;
         }
-        config_set_chat_id(argv[2], argv[3]);
+        const int chat_res = config_set_chat_id(argv[2], argv[3]);
+        if (chat_res != CONFIG_SUCCESS) {
+            return chat_res;
+        }
         puts("Chat Entry set successful.");
     }
     else if (strcmp(name, "remove-chat") == 0) {
@@ -197,9 +333,41 @@ static int modify_config(const int argc, char **argv) {
             handle_error(__func__,ERROR_INVALID_ARGUMENT);
             return ERROR_INVALID_ARGUMENT;
         }
-        config_remove_chat_by_id_or_name(value);
+        const int remove_res = config_remove_chat_by_id_or_name(value);
+        if (remove_res != CONFIG_SUCCESS) {
+            return remove_res;
+        }
         puts("Chat Entry removed successful.");
     }
+    else if (strcmp(name, "schedule") == 0) {
+        chat_schedule_t schedule = { .interval = 0, .quiet_start = CHAT_QUIET_NONE, .quiet_end = CHAT_QUIET_NONE };
+        if (argc < 4 || atoi(argv[3]) < 0 || (argc == 5 && !parse_quiet(argv[4], &schedule))) {
+            puts("Usage: config schedule <id_or_name> <minutes> [HH:MM-HH:MM|off]");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        // Without a window, the quiet window of the chat stays
+        const int pos = argc == 4 ? config_find_chat(value) : -1;
+        if (pos >= 0) {
+            schedule = *config_get_chat_schedule(pos);
+        }
+        schedule.interval = atoi(argv[3]);
+        const int schedule_res = config_set_chat_schedule(value, &schedule);
+        if (schedule_res != CONFIG_SUCCESS) {
+            return schedule_res;
+        }
+        puts("Chat schedule set successful.");
+    }
+    else if (strcmp(name, "clock") == 0) {
+        uint16_t minute;
+        if (argc != 3 || !parse_time(value, &minute)) {
+            puts("Usage: config clock <HH:MM>");
+            handle_error(__func__,ERROR_INVALID_ARGUMENT);
+            return ERROR_INVALID_ARGUMENT;
+        }
+        recipients_set_clock(minute);
+        puts("Clock set successful.");
+    }
     else if (strcmp(name, "telegram-url") == 0) {
         config_set_telegram_url(value);
         puts("Telegram URL set successful.");
@@ -225,6 +393,128 @@ static int modify_config(const int argc, char **argv) {
     return 0;
 }
 
+// Control the notification scheduler
+static int scheduler_control(const int argc, char **argv) {
+    if (argc != 2) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: scheduler <now|stop|start|status>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (strcmp(argv[1], "now") == 0) {
+        scheduler_trigger();
+        puts("Notification cycle triggered.");
+    }
+    else if (strcmp(argv[1], "stop") == 0) {
+        scheduler_stop();
+        puts("Scheduler stopped.");
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        scheduler_start();
+        puts("Scheduler started.");
+    }
+    else if (strcmp(argv[1], "status") == 0) {
+        printf("Scheduler is %s, interval %d minutes.\n",
+            scheduler_is_running() ? "running" : "stopped", config_get_notification_interval());
+        printf("Outbox: %u samples, %lu in flash, %u dropped.\n",
+            outbox_count(), (unsigned long)outbox_overflow_count(), outbox_dropped());
+        startup_print();
+    }
+    else {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: scheduler <now|stop|start|status>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    return 0;
+}
+
+// Print the stack high-water marks and the peak usage of the static buffers
+static int mem_control(const int argc, char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: mem");
+        return ERROR_INVALID_ARGUMENT;
+    }
+    mem_report_print();
+    return 0;
+}
+
+// List the sensor channels, or enable/disable sampling a channel
+static int sensors_control(const int argc, char **argv) {
+    if (argc == 1) {
+        sensors_print();
+        return 0;
+    }
+    if (argc == 3 && (strcmp(argv[2], "on") == 0 || strcmp(argv[2], "off") == 0)) {
+        const int res = sensors_enable(atoi(argv[1]), strcmp(argv[2], "on") == 0);
+        handle_error(__func__, res);
+        return res == CONFIG_SUCCESS ? 0 : res;
+    }
+    handle_error(__func__,ERROR_INVALID_ARGUMENT);
+    puts("Usage: sensors [<channel> <on|off>]");
+    return ERROR_INVALID_ARGUMENT;
+}
+
+// Print the latency histograms and counters, or reset them
+static int stats_control(const int argc, char **argv) {
+    if (argc == 1) {
+        stats_print();
+    }
+    else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        stats_reset();
+        puts("Statistics reset.");
+    }
+    else {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: stats [reset]");
+        return ERROR_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+// Print the wake-ups of the CoAP thread per cause and the radio sleep time, or reset them
+static int power_control(const int argc, char **argv) {
+    if (argc == 1) {
+        lowpower_print();
+    }
+    else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        lowpower_reset();
+        puts("Wake-up counters reset.");
+    }
+    else {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: power [reset]");
+        return ERROR_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+// Print the schedule of every chat and the time of day
+static int recipients_control(const int argc, char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: recipients");
+        return ERROR_INVALID_ARGUMENT;
+    }
+    recipients_print();
+    return 0;
+}
+
+// Print the recorded errors now, e.g. with log_auto_flush = 0
+static int log_control(const int argc, char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        puts("Usage: log");
+        return ERROR_INVALID_ARGUMENT;
+    }
+    printf("%u log records printed.\n", flush_error_log());
+    return 0;
+}
+
 // Shell commands array
 static const shell_command_t cmd_control_shell_commands[] = {
     { "led", "Control LEDs (e.g., 'led 0 on')", led_control },
@@ -232,6 +522,13 @@ static const shell_command_t cmd_control_shell_commands[] = {
     { "coap-send", "Send a custom coap message.", coap_send_control },
     { "coap-update", "Get updates from telegram.", coap_get_updates_control},
     { "config", "Change the configuration settings.", modify_config },
+    { "scheduler", "Control the notification scheduler.", scheduler_control },
+    { "mem", "Show stack high-water marks and buffer peaks.", mem_control },
+    { "stats", "Show latency percentiles and error counts (e.g., 'stats reset').", stats_control },
+    { "sensors", "List the sensor channels or toggle one (e.g., 'sensors 1 on').", sensors_control },
+    { "power", "Show the wake-ups per cause and the radio sleep time (e.g., 'power reset').", power_control },
+    { "recipients", "Show the notification schedule of every chat.", recipients_control },
+    { "log", "Print the recorded errors and messages now.", log_control },
     { NULL, NULL, NULL } // End marker
 };
 
@@ -2,99 +2,306 @@
 // Created by jonas on 19.01.25.
 //
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
+
+#include "log.h"
+#include "mutex.h"
+#include "random.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "ztimer.h"
 
 #include "net/gcoap.h"
 #include "net/sock/udp.h"
 #include "net/coap.h"
+#include "nanocbor/nanocbor.h"
 
 #include "coap_post.h"
 #include "configuration.h"
+#include "sample_buffer.h"
+#include "outbox.h"
+#include "mem_report.h"
+#include "stats.h"
+#include "lowpower.h"
+#include "update_parser.h"
 #include "utils/error_handler.h"
 
-coap_hdr_t coap_buffer[COAP_BUF_SIZE];  // Shared buffer for CoAP request
-static bool coap_response_status = false;
-char response[COAP_UPDATE_SIZE];
+// Pool of request slots, every request owns a slot from sending until its response was collected
+static coap_request_slot_t request_pool[COAP_REQUEST_SLOTS];
+static mutex_t request_pool_lock = MUTEX_INIT;      // Slots are shared by the sending threads and the gcoap thread
+static uint32_t request_sequence;
+
+// Request templates and the remote endpoint, encoded once per endpoint revision instead of for every request
+static coap_request_template_t templates[COAP_TEMPLATE_COUNT];
+static mutex_t template_lock = MUTEX_INIT;          // Templates are shared by the sending threads
+static sock_udp_ep_t template_remote;
+static uint16_t template_revision;
+static bool template_remote_valid = false;
+static bool templates_ready = false;
+
+// Session at the websocket, replaces the credentials and the chat list in every request
+static uint32_t session_id;
+static uint16_t session_revision;                   // Configuration revision the session was registered with
+static bool session_registered = false;
+
+// Command of a configuration update cut at the end of a Block2 block, completed by the next block. Only the gcoap
+// thread handles responses. A longer command is invalid anyway, it is skipped.
+static char update_tail[COAP_UPDATE_TAIL_SIZE];
+static size_t update_tail_len;
+static bool update_tail_overflow;
+
+// Observation of the configuration at the websocket, configuration updates are pushed instead of polled. The flags
+// are written by the gcoap thread and read by the CoAP and the console thread. The other fields are written before
+// the registration is sent.
+static struct {
+    atomic_bool active;                             // Observation is registered at the websocket
+    atomic_bool pending;                            // Registration is waiting for its first response
+    atomic_bool refused;                            // Websocket does not support observing for this session
+    coap_request_slot_t *slot;                      // Slot of the registration, not used by the notifications
+    uint32_t session_id;                            // Session the observation was registered with
+    sock_udp_ep_t remote;                           // Websocket endpoint, required to forget the observation
+    uint8_t token[COAP_TOKEN_LENGTH_MAX];           // Token of the observe request, matches the notifications
+    size_t token_len;
+} observe;
+
+// Get the Content-Format of the configured request encoding
+static uint16_t coap_request_format(void) {
+    return config_get_request_encoding() == REQUEST_ENCODING_CBOR ? COAP_FORMAT_CBOR : COAP_FORMAT_NONE;
+}
+
+// Check if a session is registered for the current credentials and chat list
+bool coap_session_valid(void) {
+    return session_registered && session_revision == config_get_revision();
+}
 
-// Set CoAP response handler status
-void set_coap_response_status(const bool is_done) {
-    coap_response_status = is_done;
+// Forget the current session, the next notification cycle registers again
+void coap_session_invalidate(void) {
+    session_registered = false;
 }
 
-// Get CoAP response handler status
-bool get_coap_response_status(void) {
-    return coap_response_status;
+// Store the session ID received from the websocket
+static void coap_session_set(const uint32_t id) {
+    session_id = id;
+    session_revision = config_get_revision();
+    session_registered = true;
 }
 
-// Process the 4 different types of configuration updates triggered by user updates
-void process_config_command(const char *token) {
-    // Changing LED-Feedback to either 0 or 1
-    if (token[0] == 'f' && (token[1] == '0' || token[1] == '1')) {
-        printf("Feedback received: %s\n", token);
-        config_set_led_feedback(atoi(token+1));
+// Take a free slot for a new request of the calling thread
+static coap_request_slot_t *coap_slot_acquire(const char *uri_path) {
+    coap_request_slot_t *slot = NULL;
+    uint8_t in_use = 0;
+
+    mutex_lock(&request_pool_lock);
+    for (uint8_t i = 0; i < COAP_REQUEST_SLOTS; i++) {
+        if (request_pool[i].state != COAP_SLOT_FREE) {
+            in_use++;
+        } else if (!slot) {
+            slot = &request_pool[i];
+            slot->index = i;
+            slot->state = COAP_SLOT_PENDING;
+            slot->waiter = thread_getpid();
+            slot->sequence = ++request_sequence;
+            slot->result = ERROR_COAP_TIMEOUT;
+            in_use++;
+        }
+    }
+    mutex_unlock(&request_pool_lock);
+    mem_report_use(MEM_BUFFER_COAP_SLOTS, in_use);
+
+    if (!slot) {
+        handle_error(__func__, ERROR_COAP_BUSY);
+        return NULL;
+    }
+    snprintf(slot->context.uri_path, sizeof(slot->context.uri_path), "%s", uri_path);
+    thread_flags_clear(COAP_RESPONSE_FLAG(slot->index));
+    return slot;
+}
 
-    // Changing the Interval timer to a value between 1 or 120
-    } else if (token[0] == 'i' && isdigit((int)token[1])) {
-        printf("Interval received: %s\n", token);
-        printf("test: %d\n", (int)token+1);
-        config_set_notification_interval(atoi(token+1));
+// Give a slot back to the pool, e.g. if the request could not be sent
+static void coap_slot_release(coap_request_slot_t *slot) {
+    mutex_lock(&request_pool_lock);
+    slot->state = COAP_SLOT_FREE;
+    mutex_unlock(&request_pool_lock);
+}
 
-    // Removing a User from receiving notifications
-    } else if (token[0] == 'r' && isdigit((int)token[1])) {
-        printf("Remove received: %s\n", token);
-        config_remove_chat_by_id_or_name(token+1);
+// Signal the completion of a request with its result to the waiting thread
+static void coap_complete(coap_request_slot_t *slot, const int result) {
+    // Late responses count as well, they show how far the round-trip time exceeds COAP_RESPONSE_TIMEOUT
+    if (result != ERROR_COAP_TIMEOUT && result != ERROR_COAP_SEND) {
+        stats_record(STATS_RTT, slot->sent_at);
+    }
 
-    // Adding a User to receiving notifications
+    mutex_lock(&request_pool_lock);
+    // Nobody waits for an abandoned request anymore, only free its slot
+    if (slot->state == COAP_SLOT_ABANDONED) {
+        slot->state = COAP_SLOT_FREE;
+        mutex_unlock(&request_pool_lock);
+        return;
+    }
+    slot->result = result;
+    slot->state = COAP_SLOT_DONE;
+    const kernel_pid_t waiter = slot->waiter;
+    mutex_unlock(&request_pool_lock);
+
+    if (pid_is_valid(waiter)) {
+        thread_t *thread = thread_get(waiter);
+        if (thread) {
+            thread_flags_set(thread, COAP_RESPONSE_FLAG(slot->index));
+        }
+    }
+}
+
+// Wait for the response to the request in a slot and free the slot
+static int coap_slot_wait(coap_request_slot_t *slot, const uint32_t timeout_ms) {
+    const thread_flags_t flag = COAP_RESPONSE_FLAG(slot->index);
+    ztimer_t timeout;
+    ztimer_set_timeout_flag(ZTIMER_MSEC, &timeout, timeout_ms);
+    thread_flags_wait_any(flag | THREAD_FLAG_TIMEOUT);
+    ztimer_remove(ZTIMER_MSEC, &timeout);
+    thread_flags_clear(flag | THREAD_FLAG_TIMEOUT);
+
+    // Collect the result, a late response only frees the slot
+    int result = ERROR_COAP_TIMEOUT;
+    mutex_lock(&request_pool_lock);
+    if (slot->state == COAP_SLOT_DONE) {
+        result = slot->result;
+        slot->state = COAP_SLOT_FREE;
     } else {
-        printf("Addition received: %s\n", token);
-        char *colon = strchr(token, ':');
-        printf("%s\n", colon);
-        if (colon) {
-            *colon = '\0';
-            printf("Token: %s\n", token);
-            printf("Colon: %s\n", colon+1);
-            config_set_chat_id(token, colon+1);
+        slot->state = COAP_SLOT_ABANDONED;
+        stats_count(STATS_TIMEOUTS);
+    }
+    mutex_unlock(&request_pool_lock);
+
+    return result;
+}
+
+// Wait for the response to the oldest request of the calling thread
+int coap_post_wait_response(const uint32_t timeout_ms) {
+    const kernel_pid_t self = thread_getpid();
+    coap_request_slot_t *slot = NULL;
+
+    mutex_lock(&request_pool_lock);
+    for (uint8_t i = 0; i < COAP_REQUEST_SLOTS; i++) {
+        coap_request_slot_t *candidate = &request_pool[i];
+        if (candidate->waiter == self &&
+            (candidate->state == COAP_SLOT_PENDING || candidate->state == COAP_SLOT_DONE) &&
+            (!slot || candidate->sequence < slot->sequence)) {
+            slot = candidate;
         }
     }
+    mutex_unlock(&request_pool_lock);
+
+    if (!slot) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;  // No request in flight
+    }
+    return coap_slot_wait(slot, timeout_ms);
 }
 
-// Handle CoAP POST responses
-void config_control(const coap_pkt_t *pkt) {
-    memset(response, 0, sizeof(response));
+// Get the length of the complete commands of a payload, up to and including its last ';'
+static size_t complete_commands(const update_span_t payload) {
+    size_t len = payload.len;
+    while (len > 0 && payload.data[len - 1] != ';') {
+        len--;
+    }
+    return len;
+}
 
-    if (pkt->payload_len < COAP_UPDATE_SIZE) {
-        memcpy(response, pkt->payload, pkt->payload_len);
-        response[pkt->payload_len] = '\0';
-    } else {
-        printf("Payload too large, skipping processing.\n");
+// Keep the command at the end of a block, it continues in the next block
+static void keep_tail(const char *data, const size_t len) {
+    if (update_tail_overflow || update_tail_len + len > sizeof(update_tail)) {
+        update_tail_overflow = true;
         return;
     }
+    memcpy(&update_tail[update_tail_len], data, len);
+    update_tail_len += len;
+}
 
-    // Message sent successfully: Notification update successful; No Updates: No configuration updates found
-    if (strcmp(response, "Messages sent successfully") == 0 || strcmp(response, "No Updates") == 0) {
-        printf("Received status message: %s\n", response);
-        return;
+// Apply the commands of a block of a configuration update. The command cut at the end of a block (more = true) is kept
+// in update_tail and completed by the next block, the commands in between are parsed in place.
+static unsigned config_apply_block(update_span_t payload, const bool more) {
+    unsigned failed = 0;
+
+    // Complete the command cut at the end of the previous block
+    if (update_tail_len > 0 || update_tail_overflow) {
+        const char *end = memchr(payload.data, ';', payload.len);
+        const size_t head = end ? (size_t)(end - payload.data) : payload.len;
+        keep_tail(payload.data, head);
+        if (!end && more) {
+            return 0;
+        }
+        if (update_tail_overflow) {
+            handle_error(__func__, ERROR_CONFIG_COMMAND);
+            failed++;
+        } else {
+            failed += update_parser_apply((update_span_t){ update_tail, update_tail_len });
+        }
+        update_tail_len = 0;
+        update_tail_overflow = false;
+        payload.data += end ? head + 1 : head;
+        payload.len -= end ? head + 1 : head;
     }
 
-    // Semicolons divide configuration changes in POST-response
-    char *token = strtok(response, ";");
-    while (token != NULL) {
-        process_config_command(token);
-        token = strtok(NULL, ";");
+    if (more) {
+        const size_t complete = complete_commands(payload);
+        keep_tail(payload.data + complete, payload.len - complete);
+        payload.len = complete;
+    }
+    return failed + update_parser_apply(payload);
+}
+
+// Handle CoAP POST responses, the payload is parsed in place. A Block2 response is handled block by block, a response
+// truncated by gcoap only applies its complete commands.
+void config_control(coap_pkt_t *pkt, const bool truncated) {
+    update_span_t payload = { (const char *)pkt->payload, pkt->payload_len };
+    coap_block1_t block = { .blknum = 0, .more = false };
+    const bool blockwise = coap_get_block2(pkt, &block);
+
+    // A new response starts without a tail, e.g. after a transfer which was aborted
+    if (block.blknum == 0) {
+        update_tail_len = 0;
+        update_tail_overflow = false;
+    }
+
+    // Session IDs and status messages are short, they always arrive in a single block
+    if (!truncated && block.blknum == 0 && !block.more) {
+        // Session registration: "sid=<session ID in hex>"
+        uint32_t sid;
+        if (update_parser_session(payload, &sid)) {
+            coap_session_set(sid);
+            LOG_INFO("Registered session: %08lx\n", (unsigned long)sid);
+            return;
+        }
+
+        // Message sent successfully: Notification update successful; No Updates: No configuration updates found.
+        // Received with every notification, only printed in debug builds.
+        if (update_parser_is_status(payload)) {
+            LOG_DEBUG("Received status message: %.*s\n", (int)payload.len, payload.data);
+            return;
+        }
+    }
+
+    // The last command of a truncated response is cut, e.g. a chat ID without its last digits
+    if (truncated) {
+        handle_error(__func__, ERROR_COAP_TRUNCATED);
+        payload.len = complete_commands(payload);
+    }
+
+    // Configuration changes "<command>;<command>;...", a failed command does not stop the following ones
+    const unsigned failed = config_apply_block(payload, blockwise && block.more && !truncated);
+    if (failed > 0) {
+        LOG_WARNING("%u configuration commands failed.\n", failed);
     }
 }
 
 // Response handler for CoAP requests
 static void coap_response_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pkt, const sock_udp_ep_t *remote) {
-    (void)remote;
-    set_coap_response_status(false);
-
-    // Get the context
-    coap_request_context_t *req_ctx = memo->context;
-    if (!req_ctx) {
+    // Get the slot of the request
+    coap_request_slot_t *slot = memo->context;
+    if (!slot) {
         handle_error(__func__, ERROR_NULL_POINTER);
         return;
     }
@@ -102,38 +309,56 @@ static void coap_response_handler(const gcoap_request_memo_t *memo, coap_pkt_t *
     // Handle timeouts
     if (memo->state == GCOAP_MEMO_TIMEOUT) {
         handle_error(__func__, ERROR_COAP_TIMEOUT);
+        coap_complete(slot, ERROR_COAP_TIMEOUT);
+        return;
+    }
+    if (memo->state != GCOAP_MEMO_RESP && memo->state != GCOAP_MEMO_RESP_TRUNC) {
+        handle_error(__func__, ERROR_COAP_SEND);
+        coap_complete(slot, ERROR_COAP_SEND);
         return;
     }
 
     const unsigned msg_type = (pkt->hdr->ver_t_tkl & 0x30) >> 4;
 
-    /* Handle Acknowledgements */
-    if (msg_type == COAP_TYPE_ACK) {
-        if (pkt->hdr->code == COAP_CODE_EMPTY) {
-            return;
-        }
-        set_coap_response_status(true);
+    /* Handle empty Acknowledgements, the response follows separately */
+    if (msg_type == COAP_TYPE_ACK && pkt->hdr->code == COAP_CODE_EMPTY) {
         return;
     }
 
-    /* Handle Payload */
-    if (pkt->payload_len > 0) {
-        config_control(pkt);
-        set_coap_response_status(true);
+    /* Handle unknown sessions, e.g. after a restart of the websocket */
+    if (coap_get_code_raw(pkt) == COAP_CODE_UNAUTHORIZED) {
+        coap_session_invalidate();
+        handle_error(__func__, ERROR_COAP_SESSION);
+        coap_complete(slot, ERROR_COAP_SESSION);
+        return;
+    }
+
+    /* Handle error responses */
+    if (coap_get_code_class(pkt) != COAP_CLASS_SUCCESS) {
+        handle_error(__func__, ERROR_COAP_RESPONSE);
+        coap_complete(slot, ERROR_COAP_RESPONSE);
         return;
     }
 
-    // Block wise response handling
+    /* Handle Payload, a truncated response is still delivered, only its cut command is skipped */
+    const bool truncated = memo->state == GCOAP_MEMO_RESP_TRUNC;
+    if (pkt->payload_len > 0) {
+        config_control(pkt, truncated);
+    }
+
+    // Block wise response handling, the next block is requested after the payload of this one was applied
     coap_block1_t block;
-    if (coap_get_block2(pkt, &block)) {
+    if (!truncated && coap_get_block2(pkt, &block)) {
         if (block.more) {
+            block.blknum++;
+            block.more = false;
             coap_pkt_t next_block_pkt;
             gcoap_req_init(
                 &next_block_pkt,
-                (uint8_t *)coap_buffer,
-                COAP_BUF_SIZE,
+                slot->buffer,
+                sizeof(slot->buffer),
                 COAP_METHOD_GET,
-                req_ctx->uri_path
+                slot->context.uri_path
             );
 
             coap_hdr_set_type(next_block_pkt.hdr, COAP_TYPE_NON);
@@ -141,158 +366,568 @@ static void coap_response_handler(const gcoap_request_memo_t *memo, coap_pkt_t *
 
             sock_udp_ep_t response_target = *remote;
             ssize_t res = gcoap_req_send(
-                (uint8_t *)coap_buffer,
-                next_block_pkt.payload_len,
+                slot->buffer,
+                coap_get_total_len(&next_block_pkt),
                 &response_target,
                 NULL,
                 coap_response_handler,
-                req_ctx,
+                slot,
                 GCOAP_SOCKET_TYPE_UDP
             );
 
-            if (res < 0) {
-                printf("res: %d\n", res);
+            if (res <= 0) {
                 handle_error(__func__, ERROR_COAP_SEND);
+                coap_complete(slot, ERROR_COAP_SEND);
             }
+            return;  // Completed by the response to the last block
         }
     }
 
-    set_coap_response_status(true);
+    coap_complete(slot, COAP_SUCCESS);
 }
 
-// Initialize and prepare the CoAP packet.
-static int coap_prepare_packet(coap_pkt_t *pkt, const char *uri_path, const char *payload) {
-    // Clear buffer before reuse
-    memset(coap_buffer, 0, sizeof(coap_buffer));
+// Handle the response to the observe registration and all following notifications
+static void coap_observe_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pkt, const sock_udp_ep_t *remote) {
+    (void)remote;
+    const bool registering = atomic_load(&observe.pending);
+    int result = COAP_SUCCESS;
 
-    // Initialize CoAP request
-    const int result = gcoap_req_init(
-        pkt,
-        (uint8_t *)coap_buffer,
-        COAP_BUF_SIZE,
-        COAP_METHOD_POST,
-        uri_path
-    );
-    if (result < 0) {
-        handle_error(__func__,ERROR_COAP_INIT);
-        return ERROR_COAP_INIT;
+    if (memo->state == GCOAP_MEMO_TIMEOUT) {
+        result = ERROR_COAP_TIMEOUT;
+    } else if (memo->state != GCOAP_MEMO_RESP && memo->state != GCOAP_MEMO_RESP_TRUNC) {
+        result = ERROR_COAP_SEND;
+    } else if (pkt->hdr->code == COAP_CODE_EMPTY) {
+        return;  // Empty Acknowledgement, the response follows separately
+    } else if (coap_get_code_raw(pkt) == COAP_CODE_UNAUTHORIZED) {
+        coap_session_invalidate();
+        result = ERROR_COAP_SESSION;
+    } else if (coap_get_code_class(pkt) != COAP_CLASS_SUCCESS) {
+        result = ERROR_COAP_RESPONSE;
+    } else {
+        // Without the Observe option the websocket ended (or never accepted) the observation, poll /update instead
+        atomic_store(&observe.active, coap_has_observe(pkt));
+        if (pkt->payload_len > 0) {
+            config_control(pkt, memo->state == GCOAP_MEMO_RESP_TRUNC);
+        }
     }
 
-    // Set message type to Confirmable (CON)
-    coap_hdr_set_type(pkt->hdr, COAP_TYPE_CON);
+    if (result != COAP_SUCCESS) {
+        atomic_store(&observe.active, false);
+        handle_error(__func__, result);
+    }
+    // Notifications arrive at any time, only the registration is waited for
+    if (registering) {
+        atomic_store(&observe.refused, !atomic_load(&observe.active) && result != ERROR_COAP_TIMEOUT
+            && result != ERROR_COAP_SEND);
+        atomic_store(&observe.pending, false);
+        coap_complete(observe.slot, result);
+    } else {
+        lowpower_wakeup(LOWPOWER_WAKEUP_NOTIFICATION);
+    }
+}
 
-    // Add payload
-    if (coap_opt_finish(pkt, COAP_OPT_FINISH_PAYLOAD) < 0) {
-        handle_error(__func__,ERROR_COAP_PAYLOAD);
-        return ERROR_COAP_PAYLOAD;
+// Parse the CoAP destination from the configured address and port
+static int coap_parse_remote(sock_udp_ep_t *remote) {
+    memset(remote, 0, sizeof(*remote));
+    remote->family = AF_INET6;
+    if (ipv6_addr_from_str((ipv6_addr_t *)&remote->addr, config_get_address()) == NULL) {
+        return ERROR_IPV6_FORMAT;
     }
-    size_t payload_len = strlen(payload);
-    if (payload_len >= pkt->payload_len) { // Prevent buffer overflow
-        handle_error(__func__, ERROR_COAP_PAYLOAD);
-        return ERROR_COAP_PAYLOAD;
+    remote->netif = SOCK_ADDR_ANY_NETIF;
+    remote->port = atoi(config_get_port());
+    return COAP_SUCCESS;
+}
+
+// Drop the templates and the remote if the endpoint changed since they were encoded, the caller holds the lock
+static void coap_templates_refresh(void) {
+    if (templates_ready && template_revision == config_get_endpoint_revision()) {
+        return;
+    }
+    memset(templates, 0, sizeof(templates));
+    template_remote_valid = coap_parse_remote(&template_remote) == COAP_SUCCESS;
+    template_revision = config_get_endpoint_revision();
+    templates_ready = true;
+}
+
+// Get the size of the encoded Uri-Path options, every segment has a header of 1 byte plus 1 or 2 bytes for long
+// segments
+static size_t coap_uri_path_size(const char *uri_path) {
+    size_t size = 0;
+    while (*uri_path) {
+        if (*uri_path == '/') {
+            uri_path++;
+            continue;
+        }
+        const size_t len = strcspn(uri_path, "/");
+        size += len + 1 + (len >= 13) + (len >= 269);
+        uri_path += len;
+    }
+    return size;
+}
+
+// Get the template of a URI path, it is encoded on first use: Uri-Path and (for CBOR) Content-Format (3 bytes).
+// Returns NULL if the options do not fit into the template. The caller holds the lock.
+static const coap_request_template_t *coap_template_get(const char *uri_path) {
+    coap_templates_refresh();
+
+    coap_request_template_t *template = NULL;
+    for (uint8_t i = 0; i < COAP_TEMPLATE_COUNT; i++) {
+        if (strcmp(templates[i].uri_path, uri_path) == 0) {
+            return &templates[i];
+        }
+        if (!template && templates[i].uri_path[0] == '\0') {
+            template = &templates[i];
+        }
+    }
+    if (!template) {
+        template = &templates[0];  // More URI paths than templates, replace the first one
+    }
+    if (coap_uri_path_size(uri_path) + 3 > COAP_TEMPLATE_SIZE) {
+        return NULL;
     }
 
-    memcpy(pkt->payload, payload, payload_len);
-    pkt->payload[payload_len] = '\0'; // Ensure null termination
+    snprintf(template->uri_path, sizeof(template->uri_path), "%s", uri_path);
+    uint8_t *pos = template->options;
+    pos += coap_opt_put_uri_path(pos, 0, template->uri_path);
+    template->last_option = COAP_OPT_URI_PATH;
+    const uint16_t format = coap_request_format();
+    if (format != COAP_FORMAT_NONE) {
+        pos += coap_put_option_ct(pos, template->last_option, format);
+        template->last_option = COAP_OPT_CONTENT_FORMAT;
+    }
+    template->options_len = pos - template->options;
+    return template;
+}
 
-    return COAP_PKT_SUCCESS;
+// Get the CoAP destination, it is only parsed again after the address or the port changed
+static int coap_get_remote(sock_udp_ep_t *remote) {
+    mutex_lock(&template_lock);
+    coap_templates_refresh();
+    *remote = template_remote;
+    const bool valid = template_remote_valid;
+    mutex_unlock(&template_lock);
+    return valid ? COAP_SUCCESS : ERROR_IPV6_FORMAT;
 }
 
-// Send the CoAP request to the server.
-static int coap_send_request(const coap_pkt_t *pkt) {
-    // Prepare CoAP destination
-    sock_udp_ep_t remote = { .family = AF_INET6 };
-    if (ipv6_addr_from_str((ipv6_addr_t *)&remote.addr, config_get_address()) == NULL) {
-        return ERROR_IPV6_FORMAT;
+// Write the header of a POST request into the buffer of a slot, block is NULL if the payload fits into a single
+// request. Only the message ID and the token are new, the options are copied from the template of the URI path.
+// Returns the length of the header, the payload is produced right behind it by the caller, or 0 if the options of the
+// URI path do not fit.
+static size_t coap_prepare_packet(coap_request_slot_t *slot, coap_block1_t *block, const size_t payload_len) {
+    // Confirmable request with a new message ID and a random token, like gcoap_req_init() would create it
+    uint8_t token[CONFIG_GCOAP_TOKEN_LEN];
+    random_bytes(token, sizeof(token));
+    slot->context.message_id = gcoap_next_msg_id();
+    uint8_t *pos = slot->buffer + coap_build_hdr((coap_hdr_t *)slot->buffer, COAP_TYPE_CON, token, sizeof(token),
+                                                 COAP_METHOD_POST, slot->context.message_id);
+
+    mutex_lock(&template_lock);
+    const coap_request_template_t *template = coap_template_get(slot->context.uri_path);
+    if (!template) {
+        mutex_unlock(&template_lock);
+        return 0;
+    }
+    memcpy(pos, template->options, template->options_len);
+    pos += template->options_len;
+    const uint16_t last_option = template->last_option;
+    mutex_unlock(&template_lock);
+
+    // Block-wise transfer, the first block announces the total size of the payload
+    if (block) {
+        pos += coap_opt_put_block1_control(pos, last_option, block);
+        if (block->blknum == 0) {
+            pos += coap_opt_put_uint(pos, COAP_OPT_BLOCK1, COAP_OPT_SIZE1, payload_len);
+        }
     }
-    remote.netif = SOCK_ADDR_ANY_NETIF;
-    remote.port = atoi(config_get_port());
 
-    // Send the CoAP request
-    coap_request_context_t req_ctx;
-    req_ctx.message_id = pkt->hdr->id;
-    req_ctx.uri_path = config_get_uri_path();
+    if (payload_len > 0) {
+        *pos++ = COAP_PAYLOAD_MARKER;
+    }
+    return pos - slot->buffer;
+}
 
+// Send the request in the buffer of a slot to the remote, the response is passed to the given handler. Frees the slot
+// on failure.
+static int coap_send_packet(coap_request_slot_t *slot, const size_t len, const sock_udp_ep_t *remote,
+                            const gcoap_resp_handler_t handler) {
+    slot->sent_at = stats_start();
     ssize_t coap_response = gcoap_req_send(
-        (uint8_t *) coap_buffer,
-        pkt->payload_len,
-        &remote,
+        slot->buffer,
+        len,
+        remote,
         NULL,
-        coap_response_handler,
-        (void *)&req_ctx,
+        handler,
+        slot,
         GCOAP_SOCKET_TYPE_UDP
     );
 
-    const int err = get_last_error();
-    if (coap_response <= 0 || err == ERROR_COAP_SEND || err == ERROR_COAP_TIMEOUT || err == ERROR_NULL_POINTER) {
+    stats_record(STATS_SEND, slot->sent_at);
+
+    if (coap_response <= 0) {
+        coap_slot_release(slot);
         return ERROR_COAP_SEND;
     }
+    stats_count(STATS_REQUESTS);
+    stats_add(STATS_TX_BYTES, len);
 
     return COAP_SUCCESS;
 }
 
-// Create a CoAP POST request with a given message and specific recipient.
-int coap_post_send(const char *message, const char *recipient) {
-    set_coap_response_status(false);
+// Send a POST request in a new slot, the payload is produced by the writer. Payloads larger than one block are sent
+// block-wise (Block1), every block is produced into the slot buffer and sent after the 2.31 Continue of the previous
+// one. Only the response to the last block is left for the calling thread to wait for.
+static int coap_send_request(const char *uri_path, const coap_payload_writer_t writer, const void *arg) {
+    // Prepare CoAP destination
+    sock_udp_ep_t remote;
+    if (coap_get_remote(&remote) != COAP_SUCCESS) {
+        return ERROR_IPV6_FORMAT;
+    }
 
-    if (!message) {
-        handle_error(__func__,ERROR_INVALID_ARGUMENT);
-        return ERROR_INVALID_ARGUMENT;
+    // Measure the payload, an empty window stores nothing
+    coap_window_t window = { .buffer = NULL, .offset = 0, .size = 0, .pos = 0 };
+    uint32_t start = stats_start();
+    writer(&window, arg);
+    stats_record(STATS_FORMAT, start);
+    const size_t payload_len = window.pos;
+    const bool blockwise = payload_len > COAP_BLOCK_SIZE;
+
+    coap_block1_t block = { .blknum = 0, .szx = coap_size2szx(COAP_BLOCK_SIZE), .more = false };
+    for (size_t offset = 0; ; offset += COAP_BLOCK_SIZE, block.blknum++) {
+        const size_t block_len = (payload_len - offset) < COAP_BLOCK_SIZE ? (payload_len - offset) : COAP_BLOCK_SIZE;
+        block.more = blockwise && offset + block_len < payload_len;
+
+        // Every request in flight has its own slot
+        coap_request_slot_t *slot = coap_slot_acquire(uri_path);
+        if (!slot) {
+            return ERROR_COAP_BUSY;
+        }
+
+        // Produce the payload again, only this block is stored in the slot buffer behind the header
+        start = stats_start();
+        const size_t header_len = coap_prepare_packet(slot, blockwise ? &block : NULL, payload_len);
+        stats_record(STATS_PACKET_BUILD, start);
+        if (header_len == 0) {
+            coap_slot_release(slot);
+            return ERROR_COAP_URI_PATH;
+        }
+
+        start = stats_start();
+        window = (coap_window_t){ .buffer = slot->buffer + header_len, .offset = offset, .size = block_len, .pos = 0 };
+        writer(&window, arg);
+        stats_record(STATS_FORMAT, start);
+        mem_report_use(MEM_BUFFER_COAP_PDU, header_len + block_len);
+        handle_error(__func__, COAP_PKT_SUCCESS);
+
+        int res = coap_send_packet(slot, header_len + block_len, &remote, coap_response_handler);
+        if (res != COAP_SUCCESS || !block.more) {
+            return res;
+        }
+
+        // Wait for the 2.31 Continue before sending the next block
+        res = coap_slot_wait(slot, COAP_RESPONSE_TIMEOUT);
+        if (res != COAP_SUCCESS) {
+            return res;
+        }
     }
+}
 
-    char uri_path[URI_PATH_LENGTH + 1];
-    char payload[COAP_BUF_SIZE];
+// Append a piece of the payload, only the part inside the window is stored
+static void coap_window_write(void *ctx, const void *data, const size_t len) {
+    coap_window_t *window = ctx;
+    const size_t start = window->pos;
+    const size_t end = window->pos + len;
+    const size_t window_end = window->offset + window->size;
+
+    if (end > window->offset && start < window_end) {
+        const size_t from = start > window->offset ? start : window->offset;
+        const size_t to = end < window_end ? end : window_end;
+        memcpy(window->buffer + (from - window->offset), (const uint8_t *)data + (from - start), to - from);
+    }
+    window->pos = end;
+}
 
-    // Step 1: Build URI Path
-    snprintf(uri_path, URI_PATH_LENGTH + 1, "%s", config_get_uri_path());
+// Append a string to the payload
+static void coap_window_puts(coap_window_t *window, const char *str) {
+    coap_window_write(window, str, strlen(str));
+}
 
-    // Step 2: Determine the chat ID(s)
-    const char *chat_ids;
-    if (strcmp(recipient, "all") != 0) {
-        chat_ids = config_get_chat_id_by_name(recipient);
-        if (!chat_ids) {
-            handle_error(__func__, ERROR_CHAT_ID_NOT_FOUND);
-            return ERROR_CHAT_ID_NOT_FOUND;
+// Append a form field "key=value", separated by '&' from the previous field
+static void coap_window_form(coap_window_t *window, const char *key, const char *value) {
+    if (window->pos > 0) {
+        coap_window_puts(window, "&");
+    }
+    coap_window_puts(window, key);
+    coap_window_puts(window, "=");
+    coap_window_puts(window, value);
+}
+
+// Append the CBOR items encoded so far and reset the encoder for the next items
+static void coap_window_cbor(coap_window_t *window, nanocbor_encoder_t *enc, uint8_t *items, const size_t size) {
+    coap_window_write(window, items, nanocbor_encoded_len(enc));
+    nanocbor_encoder_init(enc, items, size);
+}
+
+// Append a CBOR map entry with a text string value
+static void coap_window_cbor_tstr(coap_window_t *window, const coap_cbor_key_t key, const char *value) {
+    uint8_t items[COAP_CBOR_ITEM_SIZE];
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, items, sizeof(items));
+    nanocbor_fmt_uint(&enc, key);
+    nanocbor_fmt_tstr(&enc, strlen(value));
+    coap_window_cbor(window, &enc, items, sizeof(items));
+    coap_window_puts(window, value);
+}
+
+// Append a CBOR map entry with the IDs of a set of chats (NULL for every chat) as array of integers
+static void coap_window_cbor_chat_ids(coap_window_t *window, const chat_set_t *chats) {
+    uint8_t items[COAP_CBOR_ITEM_SIZE];
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, items, sizeof(items));
+    nanocbor_fmt_uint(&enc, COAP_CBOR_KEY_CHAT_IDS);
+    nanocbor_fmt_array(&enc, chats ? chat_set_count(chats) : config_get_chat_count());
+    coap_window_cbor(window, &enc, items, sizeof(items));
+
+    // The IDs are read from the directory, the set only holds their positions
+    for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+        if (!chats || chat_set_contains(chats, i)) {
+            nanocbor_fmt_int(&enc, config_get_chat_ids()[i]);
+            coap_window_cbor(window, &enc, items, sizeof(items));
+        }
+    }
+}
+
+// Append the form field "chat_ids=<id>,<id>,..." of a set of chats (NULL for every chat), formatted one by one
+static void coap_window_form_chat_ids(coap_window_t *window, const chat_set_t *chats) {
+    coap_window_form(window, "chat_ids", "");
+    bool first = true;
+    for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+        if (chats && !chat_set_contains(chats, i)) {
+            continue;
+        }
+        char chat_id[CHAT_ID_LENGTH + 10];
+        const int len = snprintf(chat_id, sizeof(chat_id), first ? "%lld" : ",%lld",
+            (long long)config_get_chat_ids()[i]);
+        coap_window_write(window, chat_id, len);
+        first = false;
+    }
+}
+
+// Append the start of a CBOR map (the number of entries) and the session ID or the credentials
+static void coap_write_credentials(coap_window_t *window, const bool use_session, const size_t entries) {
+    if (config_get_request_encoding() == REQUEST_ENCODING_CBOR) {
+        uint8_t items[COAP_CBOR_ITEM_SIZE];
+        nanocbor_encoder_t enc;
+        nanocbor_encoder_init(&enc, items, sizeof(items));
+        nanocbor_fmt_map(&enc, (use_session ? 1 : 2) + entries);
+        if (use_session) {
+            nanocbor_fmt_uint(&enc, COAP_CBOR_KEY_SESSION);
+            nanocbor_fmt_uint(&enc, session_id);
+            coap_window_cbor(window, &enc, items, sizeof(items));
+        } else {
+            coap_window_cbor(window, &enc, items, sizeof(items));
+            coap_window_cbor_tstr(window, COAP_CBOR_KEY_URL, config_get_telegram_url());
+            coap_window_cbor_tstr(window, COAP_CBOR_KEY_TOKEN, config_get_bot_token());
+        }
+    } else if (use_session) {
+        char sid[9];
+        snprintf(sid, sizeof(sid), "%08lx", (unsigned long)session_id);
+        coap_window_form(window, "sid", sid);
+    } else {
+        coap_window_form(window, "url", config_get_telegram_url());
+        coap_window_form(window, "token", config_get_bot_token());
+    }
+}
+
+// Produce the payload of a message request, the text or (if text is NULL) all collected samples.
+// With a session, the credentials are replaced by the session ID and the chat list may be left out (send to all).
+static void coap_write_message(coap_window_t *window, const void *arg) {
+    const coap_message_args_t *args = arg;
+
+    coap_write_credentials(window, args->use_session, (args->with_chats ? 1 : 0) + (args->piggyback ? 1 : 0) + 1);
+    if (config_get_request_encoding() == REQUEST_ENCODING_CBOR) {
+        uint8_t items[COAP_CBOR_ITEM_SIZE];
+        nanocbor_encoder_t enc;
+        nanocbor_encoder_init(&enc, items, sizeof(items));
+        if (args->with_chats) {
+            coap_window_cbor_chat_ids(window, args->chats);
+        }
+        if (args->piggyback) {
+            nanocbor_fmt_uint(&enc, COAP_CBOR_KEY_UPDATES);
+            nanocbor_fmt_bool(&enc, true);
+            coap_window_cbor(window, &enc, items, sizeof(items));
+        }
+        if (args->text) {
+            coap_window_cbor_tstr(window, COAP_CBOR_KEY_TEXT, args->text);
+        } else {
+            nanocbor_fmt_uint(&enc, COAP_CBOR_KEY_SAMPLES);
+            coap_window_cbor(window, &enc, items, sizeof(items));
+            sample_buffer_write_cbor(coap_window_write, window, args->now);
+        }
+    } else {
+        if (args->with_chats) {
+            coap_window_form_chat_ids(window, args->chats);
         }
+        if (args->piggyback) {
+            coap_window_form(window, "updates", "1");
+        }
+        if (args->text) {
+            coap_window_form(window, "text", args->text);
+        } else {
+            coap_window_form(window, "samples", "");
+            sample_buffer_write(coap_window_write, window, args->now);
+        }
+    }
+}
+
+// Produce the payload of an update request, with a session only the session ID is sent
+static void coap_write_update(coap_window_t *window, const void *arg) {
+    (void)arg;
+    coap_write_credentials(window, coap_session_valid(), 0);
+}
+
+// Produce the payload of a registration, the credentials and the chat list
+static void coap_write_register(coap_window_t *window, const void *arg) {
+    (void)arg;
+    coap_write_credentials(window, false, 1);
+    if (config_get_request_encoding() == REQUEST_ENCODING_CBOR) {
+        coap_window_cbor_chat_ids(window, NULL);
     } else {
-        chat_ids = config_get_chat_ids_string();  // Default: Send to all
+        coap_window_form_chat_ids(window, NULL);
     }
+}
 
-    // Step 3: Build Payload
-    snprintf(payload, sizeof(payload), "url=%s&token=%s&chat_ids=%s&text=%s",
-             config_get_telegram_url(), config_get_bot_token(), chat_ids, message);
+// Create a CoAP POST request with a given text (or the collected samples) for a set of chats, NULL for every chat.
+static int coap_post_message(const char *text, const chat_set_t *chats, const uint32_t now) {
+    // Step 1: Without a set every chat receives the message, the websocket knows the chat list of a session already
+    const bool use_session = coap_session_valid();
+    const coap_message_args_t args = {
+        .use_session = use_session,
+        .piggyback = !coap_observe_active(),  // Without an observation, pending updates come with the response
+        .with_chats = chats || !use_session,
+        .chats = chats,
+        .text = text,
+        .now = now,
+    };
+
+    // Step 2: Send Request, the payload is produced block by block
+    return coap_send_request(config_get_uri_path(), coap_write_message, &args);
+}
 
-    // Step 4: Prepare CoAP Packet
-    coap_pkt_t pkt;
-    if (coap_prepare_packet(&pkt, uri_path, payload) != COAP_PKT_SUCCESS) {
-        return ERROR_COAP_INIT;
+// Create a CoAP POST request with a given message and specific recipient.
+int coap_post_send(const char *message, const char *recipient) {
+    if (!message || !recipient) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    if (strcmp(recipient, "all") == 0) {
+        return coap_post_message(message, NULL, 0);
     }
-    handle_error(__func__, COAP_PKT_SUCCESS);
 
-    // Step 5: Send Request
-    return coap_send_request(&pkt);
+    const int64_t *chat_id = config_get_chat_id_by_name(recipient);
+    if (!chat_id) {
+        handle_error(__func__, ERROR_CHAT_ID_NOT_FOUND);
+        return ERROR_CHAT_ID_NOT_FOUND;
+    }
+    // The ID points into the sorted ID list, its offset is the position of the chat
+    chat_set_t chats = { 0 };
+    chat_set_add(&chats, chat_id - config_get_chat_ids());
+    return coap_post_message(message, &chats, 0);
+}
+
+// Create a CoAP POST request with a given message for several chats, merged into one request.
+int coap_post_send_to(const char *message, const chat_set_t *chats) {
+    if (!message || !chats || chat_set_count(chats) == 0) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    return coap_post_message(message, chats, 0);
+}
+
+// Create a CoAP POST request with all collected and undelivered samples for a list of chats, NULL for every chat.
+int coap_post_send_samples(const uint32_t now, const chat_set_t *chats) {
+    if (sample_buffer_count() == 0 && outbox_count() == 0) {
+        handle_error(__func__,ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    return coap_post_message(NULL, chats, now);
 }
 
 // Sending a POST request to websocket to make a get-request to fetch updates
 int coap_post_get_updates(void) {
-    set_coap_response_status(false);
+    return coap_send_request("/update", coap_write_update, NULL);
+}
+
+// Register a session at the websocket with the credentials and the chat list
+int coap_post_register(void) {
+    return coap_send_request("/register", coap_write_register, NULL);
+}
+
+// Check if the configuration is observed for the current session
+bool coap_observe_active(void) {
+    return atomic_load(&observe.active) && coap_session_valid() && observe.session_id == session_id;
+}
+
+// Check if the websocket may accept an observation for the current session
+bool coap_observe_possible(void) {
+    return coap_session_valid() && !(atomic_load(&observe.refused) && observe.session_id == session_id);
+}
 
-    char uri_path[URI_PATH_LENGTH + 1];
-    char payload[COAP_BUF_SIZE];
+// Forget the observation, notifications for it are rejected by gcoap afterward
+void coap_observe_cancel(void) {
+    if (atomic_exchange(&observe.active, false)) {
+        gcoap_obs_req_forget(&observe.remote, observe.token, observe.token_len);
+    }
+}
 
-    // Step 1: Build URI Path
-    snprintf(uri_path, URI_PATH_LENGTH + 1, "%s", "/update");
+// Register as observer of the configuration at the websocket, updates are pushed as notifications afterward
+int coap_observe_config(void) {
+    char query[9];
 
-    // Step 2: Build Payload
-    snprintf(payload, sizeof(payload), "url=%s&token=%s", config_get_telegram_url(), config_get_bot_token());
+    // Step 1: The websocket identifies the observer by its session
+    if (!coap_session_valid()) {
+        handle_error(__func__, ERROR_COAP_SESSION);
+        return ERROR_COAP_SESSION;
+    }
+    coap_observe_cancel();  // Observation of a previous session
+    snprintf(query, sizeof(query), "%08lx", (unsigned long)session_id);
 
-    // Step 3: Prepare CoAP Packet
+    // Step 2: Prepare CoAP Packet, the options have to be added in ascending order (Observe before Uri-Path)
+    if (coap_get_remote(&observe.remote) != COAP_SUCCESS) {
+        return ERROR_IPV6_FORMAT;
+    }
+    coap_request_slot_t *slot = coap_slot_acquire("/config");
+    if (!slot) {
+        return ERROR_COAP_BUSY;
+    }
     coap_pkt_t pkt;
-    if (coap_prepare_packet(&pkt, uri_path, payload) != COAP_PKT_SUCCESS) {
+    if (gcoap_req_init(&pkt, slot->buffer, sizeof(slot->buffer), COAP_METHOD_GET, NULL) < 0) {
+        coap_slot_release(slot);
+        handle_error(__func__, ERROR_COAP_INIT);
         return ERROR_COAP_INIT;
     }
-    handle_error(__func__, COAP_PKT_SUCCESS);
+    coap_hdr_set_type(pkt.hdr, COAP_TYPE_CON);
+    if (coap_opt_add_uint(&pkt, COAP_OPT_OBSERVE, 0) < 0 ||
+        coap_opt_add_uri_path(&pkt, "/config") < 0 ||
+        coap_opt_add_uri_query(&pkt, "sid", query) < 0 ||
+        coap_opt_finish(&pkt, COAP_OPT_FINISH_NONE) < 0) {
+        coap_slot_release(slot);
+        handle_error(__func__, ERROR_COAP_INIT);
+        return ERROR_COAP_INIT;
+    }
+
+    // Step 3: Remember the token and remote to forget the observation later
+    observe.token_len = coap_get_token_len(&pkt);
+    memcpy(observe.token, coap_get_token(&pkt), observe.token_len);
+    observe.session_id = session_id;
+    observe.slot = slot;
+    atomic_store(&observe.pending, true);
 
     // Step 4: Send Request
-    return coap_send_request(&pkt);
-}
\ No newline at end of file
+    slot->context.message_id = coap_get_id(&pkt);
+    mem_report_use(MEM_BUFFER_COAP_PDU, coap_get_total_len(&pkt));
+    const int res = coap_send_packet(slot, coap_get_total_len(&pkt), &observe.remote, coap_observe_handler);
+    if (res != COAP_SUCCESS) {
+        atomic_store(&observe.pending, false);
+    }
+    return res;
+}
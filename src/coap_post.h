@@ -6,48 +6,149 @@
 #define COAP_POST_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "config_constants.h"
+#include "chat_directory.h"
+#include "sched.h"
 #include "net/gcoap.h"
 
 /* Explanation of the composition of COAP_BUF_SIZE, the actual content and headers of the CoAP message:
- * 8 bytes: CoAP header (message type, token, MID)
+ * 12 bytes: CoAP header (message type, token, MID)
  * URI_PATH_LENGTH + 4: URI path option storage
- * URL_LENGTH: Telegram API URL
- * BOT_TOKEN_LENGTH: Telegram bot token
- * MAX_CHAT_IDS * (CHAT_NAME_LENGTH + CHAT_ID_LENGTH + 1): Space for all chat IDs (plus 1 for commas)
- * MESSAGE_DATA_LENGTH: Actual message content
- * 20 bytes: Extra padding for option overhead
+ * 32 bytes: Other options (Content-Format, Block1, Size1, Observe, Uri-Query) and the payload marker
+ * COAP_BLOCK_SIZE: Payload of a single request, larger payloads (credentials, chat IDs, samples, long texts) are sent
+ *                  block-wise and produced block by block, so they do not have to fit into the buffer
  */
-#define COAP_BUF_SIZE (8 + URI_PATH_LENGTH + URL_LENGTH + BOT_TOKEN_LENGTH + (MAX_CHAT_IDS * (CHAT_NAME_LENGTH + CHAT_ID_LENGTH + 1)) + MESSAGE_DATA_LENGTH + 20)
+#define COAP_BUF_SIZE (12 + URI_PATH_LENGTH + 4 + 32 + COAP_BLOCK_SIZE)
 
-/* Explanation of the composition of COAP_UPDATE_SIZE, the actual content and headers of the CoAP message:
- * 6 bytes: Configuration toggle notification interval
- * 3 bytes: Configuration toggle LED feedback
- * 2 + CHAT_ID_LENGTH: Space for remove chat ID
- * MAX_CHAT_IDS * (CHAT_NAME_LENGTH + CHAT_ID_LENGTH + 1): Space for all chat IDs (plus 1 for commas)
+/**
+ * Number of cached request templates, one for each URI path (/register, /update and the message path)
+ */
+#define COAP_TEMPLATE_COUNT 3
+
+/**
+ * Size of the encoded options of a request template: Uri-Path (URI_PATH_LENGTH + 4) and Content-Format (3)
+ */
+#define COAP_TEMPLATE_SIZE (URI_PATH_LENGTH + 4 + 3)
+
+/**
+ * Size of the scratch buffer for CBOR items, which are encoded one by one into the payload
+ */
+#define COAP_CBOR_ITEM_SIZE 24
+
+/**
+ * Maximum time to wait for a response in milliseconds
+ */
+#define COAP_RESPONSE_TIMEOUT 1000
+
+/**
+ * Maximum length of a configuration command which continues in the next Block2 block of a response.
+ */
+#define COAP_UPDATE_TAIL_SIZE 64
+
+/**
+ * Thread flag used to signal the completion of the request in a slot to the waiting thread.
+ * Bit 0 is reserved for THREAD_FLAG_EVENT of the scheduler event queue.
+ */
+#define COAP_RESPONSE_FLAG(slot) (1u << (1 + (slot)))
+
+#if COAP_REQUEST_SLOTS > 8
+#error "COAP_REQUEST_SLOTS must not exceed 8, every slot requires its own thread flag"
+#endif
+
+/**
+ * Map keys of the CBOR request encoding, small integers keep the encoded map compact
  */
-#define COAP_UPDATE_SIZE (6 + 3 + (2 + CHAT_ID_LENGTH) + (MAX_CHAT_IDS * (CHAT_NAME_LENGTH + CHAT_ID_LENGTH + 1)))
+typedef enum {
+    COAP_CBOR_KEY_URL = 0,      /**< Telegram API URL (text string) */
+    COAP_CBOR_KEY_TOKEN = 1,    /**< Telegram bot token (text string) */
+    COAP_CBOR_KEY_CHAT_IDS = 2, /**< Chat IDs (array of integers) */
+    COAP_CBOR_KEY_TEXT = 3,     /**< Message text (text string) */
+    COAP_CBOR_KEY_SAMPLES = 4,  /**< Samples [device, scale, unit, [[age, value], ...]] */
+    COAP_CBOR_KEY_SESSION = 5,  /**< Session ID (unsigned integer) */
+    COAP_CBOR_KEY_UPDATES = 6,  /**< Piggyback pending configuration updates on the response (boolean) */
+} coap_cbor_key_t;
 
 /**
  * Store the context of a request
  */
 typedef struct {
-    uint16_t message_id;        /**< Message ID of a request */
-    const char *uri_path;       /**< Pointer to the URI path of a request */
+    uint16_t message_id;                    /**< Message ID of a request */
+    char uri_path[URI_PATH_LENGTH + 1];     /**< URI path of a request, required for follow-up blocks */
 } coap_request_context_t;
 
 /**
- * Set the status of the CoAP response handler.
- * @param is_done Status of the response handler.
+ * State of a request slot
+ */
+typedef enum {
+    COAP_SLOT_FREE = 0,         /**< Slot can be used for a new request */
+    COAP_SLOT_PENDING,          /**< Request is in flight */
+    COAP_SLOT_DONE,             /**< Response arrived, waiting to be collected by the waiter */
+    COAP_SLOT_ABANDONED,        /**< Waiter timed out, the slot is freed by the response handler */
+} coap_slot_state_t;
+
+/**
+ * Request slot, every request in flight owns its own PDU buffer and context until the response was collected
+ */
+typedef struct {
+    uint8_t buffer[COAP_BUF_SIZE];          /**< PDU buffer of the request */
+    coap_request_context_t context;         /**< Context of the request, passed to the response handler */
+    kernel_pid_t waiter;                    /**< Thread collecting the response */
+    uint32_t sequence;                      /**< Order of the requests, a thread collects its oldest response first */
+    int result;                             /**< Result of the request, set by the response handler */
+    uint32_t sent_at;                       /**< Time the request was sent in µs, for the round-trip time */
+    coap_slot_state_t state;                /**< State of the slot */
+    uint8_t index;                          /**< Index in the pool, selects the thread flag */
+} coap_request_slot_t;
+
+/**
+ * Cached options of the POST requests to one URI path, encoded once per endpoint revision. Only the header (message ID
+ * and token), the Block1 options and the payload are written for every request.
+ */
+typedef struct {
+    char uri_path[URI_PATH_LENGTH + 1];     /**< URI path of the requests, empty if the template is unused */
+    uint8_t options[COAP_TEMPLATE_SIZE];    /**< Encoded Uri-Path and Content-Format options */
+    uint8_t options_len;                    /**< Length of the encoded options */
+    uint16_t last_option;                   /**< Number of the last encoded option, the next option refers to it */
+} coap_request_template_t;
+
+/**
+ * Window of a payload which is produced in pieces, only the bytes [offset, offset + size) are stored in the buffer.
+ * The payload is produced once per block, which keeps the RAM usage at one block independent of the payload size.
+ */
+typedef struct {
+    uint8_t *buffer;                        /**< Buffer receiving the bytes inside the window */
+    size_t offset;                          /**< Offset of the window in the payload */
+    size_t size;                            /**< Size of the window */
+    size_t pos;                             /**< Number of bytes produced so far, the payload length afterward */
+} coap_window_t;
+
+/**
+ * Produce the whole payload of a request into a window
+ */
+typedef void (*coap_payload_writer_t)(coap_window_t *window, const void *arg);
+
+/**
+ * Arguments of a message request, the payload is produced from them for every block
  */
-void set_coap_response_status(bool is_done);
+typedef struct {
+    bool use_session;                       /**< Send the session ID instead of the credentials */
+    bool piggyback;                         /**< Ask for the pending configuration updates in the response */
+    bool with_chats;                        /**< Send a chat list, without it the session knows the chats */
+    const chat_set_t *chats;                /**< Chats of the list, NULL for every chat */
+    const char *text;                       /**< Message text, NULL to send the collected samples */
+    uint32_t now;                           /**< Current time in milliseconds, for the age of the samples */
+} coap_message_args_t;
 
 /**
- * Get the current status of the CoAP response handler.
- * @return Whether CoAP response handler is finished or not.
+ * Wait for the response to the oldest request in flight sent by the calling thread and free its slot.
+ * The response handler signals the completion with a thread flag of the slot, no polling is involved. A thread can send
+ * several requests (up to COAP_REQUEST_SLOTS in total) and collect their responses afterward in the same order.
+ * @param timeout_ms Maximum time to wait in milliseconds.
+ * @return Result of the request, ERROR_COAP_TIMEOUT if there was no response in time.
  */
-bool get_coap_response_status(void);
+int coap_post_wait_response(uint32_t timeout_ms);
 
 /**
  * Create and send a CoAP POST request with a given message.
@@ -57,12 +158,77 @@ bool get_coap_response_status(void);
  */
 int coap_post_send(const char *message, const char *recipient);
 
+/**
+ * Create and send a CoAP POST request with a given message to several chats at once.
+ * @param message The message to send.
+ * @param chats The recipients, the list is sent in a single request.
+ * @return Custom codes defined in error_handler.h.
+ */
+int coap_post_send_to(const char *message, const chat_set_t *chats);
+
+/**
+ * Create and send a CoAP POST request with all samples of the sample buffer and the outbox.
+ * The websocket expands the batch into one line per sample.
+ * @param now Current time in milliseconds, used to calculate the age of the samples.
+ * @param chats The recipients, NULL for every chat.
+ * @return Custom codes defined in error_handler.h.
+ */
+int coap_post_send_samples(uint32_t now, const chat_set_t *chats);
+
+/**
+ * Check if a session is registered at the websocket for the current credentials and chat list.
+ * @return Whether requests can use the session ID instead of the credentials.
+ */
+bool coap_session_valid(void);
+
+/**
+ * Forget the current session, e.g. after the websocket did not recognize it.
+ */
+void coap_session_invalidate(void);
+
+/**
+ * Create a CoAP POST request to register a session with the credentials and the chat list.
+ * The session ID in the response is used for all following requests.
+ * @return Custom codes defined in error_handler.h.
+ */
+int coap_post_register(void);
+
 /**
  * Create a CoAP POST request to get updates.
  * @return Custom codes defined in error_handler.h.
  */
 int coap_post_get_updates(void);
 
-//void config_control(coap_pkt_t *pkt);
+/**
+ * Create a CoAP GET request to observe the configuration of the current session at the websocket (/config).
+ * The response and all following Observe notifications are processed like the response of coap_post_get_updates().
+ * @return Custom codes defined in error_handler.h, ERROR_COAP_SESSION if there is no valid session.
+ */
+int coap_observe_config(void);
+
+/**
+ * Check if the configuration is observed for the current session, polling /update is not required then.
+ * @return Whether configuration updates are pushed by the websocket.
+ */
+bool coap_observe_active(void);
+
+/**
+ * Check if an observation can be registered, i.e. there is a valid session and the websocket did not refuse to 
+ * observe for this session before (e.g. an older websocket without /config).
+ * @return Whether coap_observe_config() is worth trying.
+ */
+bool coap_observe_possible(void);
+
+/**
+ * Forget the observation of the configuration, the websocket stops sending notifications.
+ */
+void coap_observe_cancel(void);
+
+/**
+ * Handle the payload of a websocket response: a session ID, a status message or configuration commands.
+ * @param pkt The CoAP packet.
+ * @param truncated Whether gcoap cut the response, its last command is skipped.
+ */
+void config_control(coap_pkt_t *pkt, bool truncated);
 
 #endif //COAP_POST_H
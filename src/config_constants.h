@@ -17,14 +17,29 @@
  */
 
 #define BOT_TOKEN_LENGTH 50         // The length of the telegram bot token. [47]
-#define MAX_CHAT_IDS 10             // The maximum number of telegram chats.
+#define MAX_CHAT_IDS 16             // The maximum number of telegram chats, each uses 8 bytes plus its name.
 #define CHAT_ID_LENGTH 12           // The length of a single telegram chat id. [11]
 #define CHAT_NAME_LENGTH 15         // The length of the associated first name to the chat id.
+#define CHAT_NAME_POOL_SIZE 128     // The space shared by the names of all telegram chats, each uses its length + 1.
+#define MAX_SCHEDULED_CHATS 4       // The maximum number of chats with an interval or a quiet window of their own.
 #define URL_LENGTH 30               // The length of the telegram bot url. [29]
 #define ADDRESS_LENGTH 40           // The length of the IPv6 address from the CoAP server, enough space for any IPv6 address. [39]
 #define PORT_LENGTH 5               // The length of the CoAP server port. [4]
 #define URI_PATH_LENGTH 20          // The length of the CoAP server endpoint.
 #define MESSAGE_DATA_LENGTH 40      // The maximum size of the actual message payload.
+#define COAP_REQUEST_SLOTS 3        // The maximum number of CoAP requests in flight at the same time.
+#define COAP_BLOCK_SIZE 64          // The payload size of a single request, larger payloads are sent block-wise. [16, 32, ..., 1024]
+#define SAMPLE_BUFFER_SIZE 12       // The maximum number of samples stored before they are sent.
+#define SAMPLE_DATA_LENGTH 24       // The length of a single CBOR encoded sample [age, mean, min, max, count]. [18]
+#define SENSORS_MAX_CHANNELS 8      // The maximum number of sampled sensor channels (one per dimension of a sensor).
+#define ALERT_MAX_RULES 8           // The maximum number of alert rules (thresholds and rates of change). [8]
+#define OUTBOX_SIZE 48              // The maximum number of undelivered samples kept in RAM.
+#define OUTBOX_MTD_SECTORS 2        // The number of flash sectors used for undelivered samples on boards with MTD.
+#define CONFIG_STORE_MTD_SECTORS 2  // The number of flash sectors used for the stored configuration, used alternately.
+#define TIMER_WHEEL_SLOTS 64        // The number of slots of the timer wheel driving the notification cycle and the chats.
+#define TIMER_WHEEL_TICK 1000       // The length (in ms) of a tick of the timer wheel, the resolution of all its timers.
+#define STARTUP_POLL_INTERVAL 100   // The longest interval (in ms) in which the interface and the default route are checked at startup.
+#define STARTUP_GATEWAY_RETRY 1000  // The delay (in ms) between two registrations at the websocket at startup.
 
 
 /* If any of the required configuration variables is not set during building, this will make sure to initialize these
@@ -35,6 +50,63 @@
 #define TEMPERATURE_NOTIFICATION_INTERVAL 5
 #endif
 
+// Length (in ms) of one unit of the notification interval, the benchmark shortens it to seconds
+#ifndef INTERVAL_UNIT
+#define INTERVAL_UNIT 60000
+#endif
+
+#ifndef SAMPLE_BATCH_SIZE
+#define SAMPLE_BATCH_SIZE 10
+#endif
+
+#ifndef SAMPLE_MAX_AGE
+#define SAMPLE_MAX_AGE 60
+#endif
+
+#ifndef SENSOR_CLASSES
+#define SENSOR_CLASSES "temp"
+#endif
+
+#ifndef SAMPLE_SUBINTERVAL
+#define SAMPLE_SUBINTERVAL 0
+#endif
+
+#ifndef REPORT_DEADBAND
+#define REPORT_DEADBAND 0
+#endif
+
+#ifndef REPORT_HEARTBEAT
+#define REPORT_HEARTBEAT 12
+#endif
+
+#ifndef OUTBOX_RETRY_BASE
+#define OUTBOX_RETRY_BASE 30
+#endif
+
+#ifndef OUTBOX_RETRY_MAX
+#define OUTBOX_RETRY_MAX 1800
+#endif
+
+#ifndef REQUEST_ENCODING
+#define REQUEST_ENCODING REQUEST_ENCODING_CBOR
+#endif
+
+#ifndef STARTUP_TIMEOUT
+#define STARTUP_TIMEOUT 60
+#endif
+
+#ifndef STARTUP_WAIT_GATEWAY
+#define STARTUP_WAIT_GATEWAY 0
+#endif
+
+#ifndef ENABLE_OUTBOX_FLASH
+#define ENABLE_OUTBOX_FLASH 0
+#endif
+
+#ifndef ENABLE_LOW_POWER
+#define ENABLE_LOW_POWER 0
+#endif
+
 #ifndef ENABLE_LED_FEEDBACK
 #define ENABLE_LED_FEEDBACK 0
 #endif
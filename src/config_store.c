@@ -0,0 +1,423 @@
+//
+// Created by vincent on 3/14/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "checksum/crc16_ccitt.h"
+
+#include "config_store.h"
+#include "configuration.h"
+#include "scheduler.h"
+#include "utils/error_handler.h"
+
+#ifdef MODULE_MTD
+#include "board.h"
+#include "mtd.h"
+#endif
+
+static config_store_t store;
+
+#if defined(MODULE_MTD) && defined(MTD_0)
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+// The build-time defaults from config.ini, a record based on other defaults belongs to another build
+static const char build_defaults[] = TELEGRAM_BOT_TOKEN "|" TELEGRAM_CHAT_IDS "|" TELEGRAM_SERVER_URL "|"
+    COAP_SERVER_ADDRESS "|" COAP_SERVER_PORT "|" COAP_SERVER_URI_PATH "|"
+    STRINGIFY(TEMPERATURE_NOTIFICATION_INTERVAL) "|" STRINGIFY(SAMPLE_BATCH_SIZE) "|" STRINGIFY(SAMPLE_MAX_AGE) "|"
+    STRINGIFY(REPORT_DEADBAND) "|" STRINGIFY(REPORT_HEARTBEAT) "|" STRINGIFY(REQUEST_ENCODING) "|"
+    STRINGIFY(ENABLE_LED_FEEDBACK);
+
+/**
+ * Sequential writer of a record, which only measures the body in a dry run
+ */
+typedef struct {
+    uint32_t addr;                              /**< Flash address of the next chunk */
+    uint16_t crc;                               /**< CRC of the data written so far */
+    uint16_t length;                            /**< Number of bytes written so far */
+    uint8_t chunk[CONFIG_STORE_ALIGN];          /**< Data waiting to be written */
+    uint8_t fill;                               /**< Number of bytes in chunk */
+    bool dry;                                   /**< Only compute length and CRC */
+    int result;                                 /**< First error of the flash device, 0 on success */
+} record_writer_t;
+
+/**
+ * Sequential reader of a record body, reading beyond the body fails
+ */
+typedef struct {
+    uint32_t addr;                              /**< Flash address of the next byte */
+    uint32_t end;                               /**< Flash address behind the body */
+    bool ok;                                    /**< Whether all reads were inside the body */
+} record_reader_t;
+
+// Address of the newest valid record, 0 if there is none
+static uint32_t newest_addr;
+
+// The configuration store uses the sectors in front of the outbox overflow at the end of the first MTD device
+static mtd_dev_t *store_mtd(void) {
+    return MTD_0;
+}
+
+static uint32_t sector_addr(const uint8_t sector) {
+    const mtd_dev_t *mtd = store_mtd();
+    return (mtd->sector_count - OUTBOX_MTD_SECTORS - CONFIG_STORE_MTD_SECTORS + sector) * store.sector_size;
+}
+
+static uint32_t record_size(const uint16_t length) {
+    const uint32_t size = sizeof(config_record_header_t) + length;
+    return (size + CONFIG_STORE_ALIGN - 1) / CONFIG_STORE_ALIGN * CONFIG_STORE_ALIGN;
+}
+
+static uint16_t defaults_crc(void) {
+    return crc16_ccitt_false_update(0xFFFF, (const unsigned char *)build_defaults, sizeof(build_defaults) - 1);
+}
+
+// Write the chunk to flash, a partial chunk is padded with erased bytes
+static void record_flush(record_writer_t *w) {
+    if (w->fill == 0) {
+        return;
+    }
+    memset(w->chunk + w->fill, 0xFF, CONFIG_STORE_ALIGN - w->fill);
+    mtd_dev_t *mtd = store_mtd();
+    const int res = mtd_write_page_raw(mtd, w->chunk, w->addr / mtd->page_size, w->addr % mtd->page_size,
+                                       CONFIG_STORE_ALIGN);
+    if (res != 0 && w->result == 0) {
+        w->result = res;
+    }
+    w->addr += CONFIG_STORE_ALIGN;
+    w->fill = 0;
+}
+
+static void record_write(record_writer_t *w, const void *data, const size_t len) {
+    w->crc = crc16_ccitt_false_update(w->crc, data, len);
+    w->length += len;
+    if (w->dry) {
+        return;
+    }
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        w->chunk[w->fill++] = bytes[i];
+        if (w->fill == CONFIG_STORE_ALIGN) {
+            record_flush(w);
+        }
+    }
+}
+
+// Values are stored in little endian, independent of the CPU
+static void put_uint(record_writer_t *w, const uint64_t value, const uint8_t size) {
+    uint8_t bytes[8];
+    for (uint8_t i = 0; i < size; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+    record_write(w, bytes, size);
+}
+
+static void put_str(record_writer_t *w, const char *str) {
+    const uint8_t len = strnlen(str, UINT8_MAX);
+    put_uint(w, len, 1);
+    record_write(w, str, len);
+}
+
+static void record_read(record_reader_t *r, void *dest, const size_t len) {
+    if (!r->ok || r->addr + len > r->end || mtd_read(store_mtd(), dest, r->addr, len) != 0) {
+        r->ok = false;
+        memset(dest, 0, len);
+        return;
+    }
+    r->addr += len;
+}
+
+static uint64_t get_uint(record_reader_t *r, const uint8_t size) {
+    uint8_t bytes[8];
+    uint64_t value = 0;
+    record_read(r, bytes, size);
+    for (uint8_t i = 0; i < size; i++) {
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+// Read a string into a buffer, longer strings are cut like by the setters
+static void get_str(record_reader_t *r, char *dest, const size_t size) {
+    const uint8_t len = get_uint(r, 1);
+    const size_t keep = len < size ? len : size - 1;
+    record_read(r, dest, keep);
+    dest[keep] = '\0';
+    r->addr += len - keep;
+}
+
+/* Layout of the body (version 3), all integers in little endian:
+ * u16 interval, u8 led feedback, u8 batch size, u16 max age, u8 encoding, i16 deadband, u16 heartbeat,
+ * str bot token, str telegram url, str address, str port, str uri path (str = u8 length + characters),
+ * u16 number of chats, per chat: i64 chat id, str name, u16 interval, u16 quiet start, u16 quiet end,
+ * u8 number of alert rules, per rule: u8 channel, u8 kind, i32 limit, i32 hysteresis
+ */
+static void serialize(record_writer_t *w) {
+    put_uint(w, app_config.temperature_notification_interval, 2);
+    put_uint(w, app_config.enable_led_feedback, 1);
+    put_uint(w, app_config.sample_batch_size, 1);
+    put_uint(w, app_config.sample_max_age, 2);
+    put_uint(w, app_config.request_encoding, 1);
+    put_uint(w, (uint16_t)app_config.report_deadband, 2);
+    put_uint(w, app_config.report_heartbeat, 2);
+    put_str(w, app_config.bot_token);
+    put_str(w, app_config.telegram_url);
+    put_str(w, app_config.address);
+    put_str(w, app_config.port);
+    put_str(w, app_config.uri_path);
+
+    const chat_directory_t *chats = &app_config.chat_ids;
+    put_uint(w, chats->count, 2);
+    for (chat_index_t i = 0; i < chats->count; i++) {
+        const chat_schedule_t *schedule = chat_directory_schedule(chats, i);
+        put_uint(w, (uint64_t)chats->ids[i], 8);
+        put_str(w, chat_directory_name(chats, i));
+        put_uint(w, schedule->interval, 2);
+        put_uint(w, schedule->quiet_start, 2);
+        put_uint(w, schedule->quiet_end, 2);
+    }
+
+    put_uint(w, app_config.alert_rule_count, 1);
+    for (uint8_t i = 0; i < app_config.alert_rule_count; i++) {
+        const alert_rule_t *rule = &app_config.alert_rules[i];
+        put_uint(w, rule->channel, 1);
+        put_uint(w, rule->kind, 1);
+        put_uint(w, (uint32_t)rule->limit, 4);
+        put_uint(w, (uint32_t)rule->hysteresis, 4);
+    }
+}
+
+static bool deserialize(record_reader_t *r) {
+    app_config.temperature_notification_interval = get_uint(r, 2);
+    app_config.enable_led_feedback = get_uint(r, 1) != 0;
+    app_config.sample_batch_size = get_uint(r, 1);
+    app_config.sample_max_age = get_uint(r, 2);
+    app_config.request_encoding = get_uint(r, 1) == REQUEST_ENCODING_TEXT
+        ? REQUEST_ENCODING_TEXT : REQUEST_ENCODING_CBOR;
+    app_config.report_deadband = (int16_t)get_uint(r, 2);
+    app_config.report_heartbeat = get_uint(r, 2);
+    get_str(r, app_config.bot_token, BOT_TOKEN_LENGTH);
+    get_str(r, app_config.telegram_url, URL_LENGTH);
+    get_str(r, app_config.address, ADDRESS_LENGTH);
+    get_str(r, app_config.port, PORT_LENGTH);
+    get_str(r, app_config.uri_path, URI_PATH_LENGTH);
+
+    chat_directory_clear(&app_config.chat_ids);
+    const uint16_t count = get_uint(r, 2);
+    for (uint16_t i = 0; i < count && r->ok; i++) {
+        char name[CHAT_NAME_LENGTH];
+        char id_str[21];
+        const int64_t id = (int64_t)get_uint(r, 8);
+        get_str(r, name, sizeof(name));
+        chat_schedule_t schedule;
+        schedule.interval = get_uint(r, 2);
+        schedule.quiet_start = get_uint(r, 2);
+        schedule.quiet_end = get_uint(r, 2);
+        chat_directory_set(&app_config.chat_ids, name, id);
+        snprintf(id_str, sizeof(id_str), "%lld", (long long)id);
+        chat_directory_set_schedule(&app_config.chat_ids, id_str, &schedule);
+    }
+
+    // Rules of a record written by a build with more rules are dropped
+    const uint8_t rules = get_uint(r, 1);
+    app_config.alert_rule_count = 0;
+    for (uint8_t i = 0; i < rules && r->ok; i++) {
+        alert_rule_t rule;
+        rule.channel = get_uint(r, 1);
+        rule.kind = get_uint(r, 1);
+        rule.limit = (int32_t)get_uint(r, 4);
+        rule.hysteresis = (int32_t)get_uint(r, 4);
+        if (app_config.alert_rule_count < ALERT_MAX_RULES) {
+            app_config.alert_rules[app_config.alert_rule_count++] = rule;
+        }
+    }
+    return r->ok;
+}
+
+// Check the CRC of a record body
+static bool body_valid(const uint32_t addr, const config_record_header_t *header) {
+    uint8_t chunk[CONFIG_STORE_ALIGN];
+    uint16_t crc = 0xFFFF;
+    for (uint32_t pos = 0; pos < header->length; pos += sizeof(chunk)) {
+        const uint32_t len = header->length - pos < sizeof(chunk) ? header->length - pos : sizeof(chunk);
+        if (mtd_read(store_mtd(), chunk, addr + sizeof(*header) + pos, len) != 0) {
+            return false;
+        }
+        crc = crc16_ccitt_false_update(crc, chunk, len);
+    }
+    return crc == header->crc;
+}
+
+// Walk the records of a sector and remember the newest valid one. Returns the offset behind the last record, or the
+// sector size if the sector contains anything else, e.g. an interrupted write, so it is not appended to anymore.
+static uint32_t scan_sector(const uint8_t sector, const uint16_t defaults, uint32_t *newest_sequence) {
+    uint32_t offset = 0;
+    while (offset + sizeof(config_record_header_t) <= store.sector_size) {
+        config_record_header_t header;
+        const uint32_t addr = sector_addr(sector) + offset;
+        if (mtd_read(store_mtd(), &header, addr, sizeof(header)) != 0) {
+            return store.sector_size;
+        }
+        if (header.magic == 0xFFFF && header.length == 0xFFFF) {
+            return offset;
+        }
+        if (header.magic != CONFIG_STORE_MAGIC || offset + record_size(header.length) > store.sector_size) {
+            return store.sector_size;
+        }
+
+        // New records have to continue the sequence of all records, also of the ones of other builds
+        if (header.sequence > store.sequence) {
+            store.sequence = header.sequence;
+        }
+        if (header.version == CONFIG_STORE_VERSION && header.defaults == defaults
+            && (newest_addr == 0 || header.sequence > *newest_sequence) && body_valid(addr, &header)) {
+            newest_addr = addr;
+            *newest_sequence = header.sequence;
+            store.sector = sector;
+        }
+        offset += record_size(header.length);
+    }
+    return store.sector_size;
+}
+
+void config_store_init(void) {
+    mtd_dev_t *mtd = store_mtd();
+    if (mtd_init(mtd) != 0 || mtd->sector_count <= OUTBOX_MTD_SECTORS + CONFIG_STORE_MTD_SECTORS) {
+        handle_error(__func__, ERROR_CONFIG_STORE);
+        return;
+    }
+    store.sector_size = mtd->pages_per_sector * mtd->page_size;
+    store.available = true;
+
+    // Continue appending to the sector of the newest record
+    uint32_t ends[CONFIG_STORE_MTD_SECTORS];
+    uint32_t newest_sequence = 0;
+    for (uint8_t sector = 0; sector < CONFIG_STORE_MTD_SECTORS; sector++) {
+        ends[sector] = scan_sector(sector, defaults_crc(), &newest_sequence);
+    }
+    store.end = ends[store.sector];
+}
+
+bool config_store_load(void) {
+    if (!store.available || newest_addr == 0) {
+        return false;
+    }
+
+    config_record_header_t header;
+    if (mtd_read(store_mtd(), &header, newest_addr, sizeof(header)) != 0) {
+        return false;
+    }
+    record_reader_t reader = {
+        .addr = newest_addr + sizeof(header),
+        .end = newest_addr + sizeof(header) + header.length,
+        .ok = true,
+    };
+    if (!deserialize(&reader)) {
+        handle_error(__func__, ERROR_CONFIG_STORE);
+        return false;
+    }
+    return true;
+}
+
+int config_store_save(void) {
+    if (!store.available) {
+        return ERROR_CONFIG_STORE;
+    }
+
+    // Measure the body first, the header with length and CRC is written in front of it
+    record_writer_t writer = { .crc = 0xFFFF, .dry = true };
+    serialize(&writer);
+    const uint32_t size = record_size(writer.length);
+    if (size > store.sector_size) {
+        handle_error(__func__, ERROR_CONFIG_STORE);
+        return ERROR_CONFIG_STORE;
+    }
+
+    // Move on to the next sector if the record does not fit anymore, the old sector keeps the previous record
+    if (store.end + size > store.sector_size) {
+        store.sector = (store.sector + 1) % CONFIG_STORE_MTD_SECTORS;
+        store.end = 0;
+        if (mtd_erase_sector(store_mtd(), sector_addr(store.sector) / store.sector_size, 1) != 0) {
+            store.end = store.sector_size;
+            handle_error(__func__, ERROR_CONFIG_STORE);
+            return ERROR_CONFIG_STORE;
+        }
+    }
+
+    const config_record_header_t header = {
+        .magic = CONFIG_STORE_MAGIC,
+        .version = CONFIG_STORE_VERSION,
+        .reserved = 0xFF,
+        .length = writer.length,
+        .defaults = defaults_crc(),
+        .sequence = ++store.sequence,
+        .crc = writer.crc,
+        .padding = 0xFFFF,
+    };
+    writer = (record_writer_t){ .addr = sector_addr(store.sector) + store.end, .crc = 0xFFFF };
+    record_write(&writer, &header, sizeof(header));
+    serialize(&writer);
+    record_flush(&writer);
+
+    store.end += size;
+    if (writer.result != 0) {
+        store.end = store.sector_size;  // Do not append behind a broken record
+        handle_error(__func__, ERROR_CONFIG_STORE);
+        return ERROR_CONFIG_STORE;
+    }
+    return CONFIG_SUCCESS;
+}
+
+int config_store_erase(void) {
+    if (!store.available) {
+        return ERROR_CONFIG_STORE;
+    }
+    if (mtd_erase_sector(store_mtd(), sector_addr(0) / store.sector_size, CONFIG_STORE_MTD_SECTORS) != 0) {
+        handle_error(__func__, ERROR_CONFIG_STORE);
+        return ERROR_CONFIG_STORE;
+    }
+    store.sector = 0;
+    store.end = 0;
+    newest_addr = 0;
+    return CONFIG_SUCCESS;
+}
+
+// Event: write the configuration from the CoAP thread
+static void on_save(event_t *event) {
+    (void)event;
+    config_store_save();
+}
+
+static event_t save_event = { .handler = on_save };
+
+void config_store_schedule_save(void) {
+    if (store.available) {
+        scheduler_post(&save_event);
+    }
+}
+
+#else
+
+void config_store_init(void) {
+    store.available = false;
+}
+
+bool config_store_load(void) {
+    return false;
+}
+
+int config_store_save(void) {
+    return ERROR_CONFIG_STORE;
+}
+
+void config_store_schedule_save(void) {
+}
+
+int config_store_erase(void) {
+    return ERROR_CONFIG_STORE;
+}
+
+#endif
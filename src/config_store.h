@@ -0,0 +1,83 @@
+//
+// Created by vincent on 3/14/25.
+//
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Version of the binary layout of the stored configuration, records of other versions are ignored
+ */
+#define CONFIG_STORE_VERSION 3
+
+/**
+ * Marks the start of a record, erased flash (0xFFFF) marks the end of the records in a sector
+ */
+#define CONFIG_STORE_MAGIC 0xC0F1
+
+/**
+ * Records start at multiples of this size and are written in chunks of this size, which matches the write
+ * granularity of common flash devices
+ */
+#define CONFIG_STORE_ALIGN 16
+
+/**
+ * Header of a stored configuration record, followed by the body
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t magic;                             /**< CONFIG_STORE_MAGIC */
+    uint8_t version;                            /**< CONFIG_STORE_VERSION */
+    uint8_t reserved;                           /**< Always 0xFF */
+    uint16_t length;                            /**< Length of the body in bytes */
+    uint16_t defaults;                          /**< CRC of the build-time defaults the record is based on */
+    uint32_t sequence;                          /**< Increases with every record, the highest valid one is loaded */
+    uint16_t crc;                               /**< CRC-16 (CCITT) of the body */
+    uint16_t padding;                           /**< Always 0xFFFF */
+} config_record_header_t;
+
+/**
+ * Store the position of the records in flash
+ */
+typedef struct {
+    bool available;                             /**< Whether the board provides flash for the configuration */
+    uint8_t sector;                             /**< Sector of the store which the next record is appended to */
+    uint32_t end;                               /**< Offset in the sector where the next record is appended */
+    uint32_t sequence;                          /**< Sequence number of the newest record */
+    uint32_t sector_size;                       /**< Size of a sector in bytes */
+} config_store_t;
+
+/**
+ * Initialize the flash device and find the newest valid record. Without MTD, the store is unavailable and the
+ * configuration is not persisted.
+ */
+void config_store_init(void);
+
+/**
+ * Apply the newest valid record to app_config. Records written by a firmware built with different defaults
+ * (config.ini) are ignored, so a new build always starts with its own configuration.
+ * @return Whether a record was loaded.
+ */
+bool config_store_load(void);
+
+/**
+ * Append a record with the current configuration. If the current sector is full, the next sector is erased and used,
+ * so the previous record stays valid until the new one is completely written.
+ * @return Custom codes defined in error_handler.h.
+ */
+int config_store_save(void);
+
+/**
+ * Save the configuration from the CoAP thread, several changes in a row are written as one record.
+ */
+void config_store_schedule_save(void);
+
+/**
+ * Erase all stored records, the build-time defaults are used after the next reboot.
+ * @return Custom codes defined in error_handler.h.
+ */
+int config_store_erase(void);
+
+#endif //CONFIG_STORE_H
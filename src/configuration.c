@@ -6,14 +6,46 @@
 #include <stdio.h>
 
 #include "configuration.h"
+#include "scheduler.h"
+#include "config_store.h"
+#include "recipients.h"
+#include "mem_report.h"
 #include "utils/error_handler.h"
 
 config_t app_config;
 
-void config_init(void) {
-    // Set default values (from CFLAGS)
+// Changes whenever the credentials or the chat list change, e.g. to invalidate the websocket session
+static uint16_t config_revision = 0;
+static uint16_t endpoint_revision = 0;
+
+// Whether the configuration is initialized, changes before are not stored
+static bool config_ready = false;
+
+// Store the configuration after a change, the record is written by the CoAP thread
+static void config_changed(void) {
+    if (config_ready) {
+        config_store_schedule_save();
+    }
+}
+
+// Rearm the timers of the chats with their own schedule, the scheduler arms them at startup
+static void chats_changed(void) {
+    if (config_ready) {
+        recipients_changed();
+    }
+    config_changed();
+}
+
+// Set the default values (from CFLAGS)
+static void config_set_defaults(void) {
     app_config.temperature_notification_interval = TEMPERATURE_NOTIFICATION_INTERVAL;
     app_config.enable_led_feedback = (ENABLE_LED_FEEDBACK == 1) ? true : false;
+    config_set_sample_batch_size(SAMPLE_BATCH_SIZE);
+    config_set_sample_max_age(SAMPLE_MAX_AGE);
+    app_config.request_encoding = REQUEST_ENCODING;
+    app_config.report_deadband = REPORT_DEADBAND;
+    app_config.report_heartbeat = REPORT_HEARTBEAT;
+    app_config.alert_rule_count = 0;
     snprintf(app_config.bot_token, BOT_TOKEN_LENGTH, "%s", TELEGRAM_BOT_TOKEN);
     snprintf(app_config.telegram_url, URL_LENGTH, "%s", TELEGRAM_SERVER_URL);
     snprintf(app_config.address, ADDRESS_LENGTH, "%s", COAP_SERVER_ADDRESS);
@@ -21,88 +53,200 @@ void config_init(void) {
     snprintf(app_config.uri_path, URI_PATH_LENGTH, "%s", COAP_SERVER_URI_PATH);
 
     // Parse TELEGRAM_CHAT_IDS (Format: "UserName:123456789,...")
-    char chat_ids_copy[MAX_CHAT_IDS*(CHAT_ID_LENGTH+1)];
-    snprintf(chat_ids_copy, MAX_CHAT_IDS*(CHAT_ID_LENGTH+1), "%s", TELEGRAM_CHAT_IDS);
-    chat_ids_copy[sizeof(chat_ids_copy) - 1] = '\0';  // Ensure null-termination
+    char chat_ids_copy[sizeof(TELEGRAM_CHAT_IDS)];
+    snprintf(chat_ids_copy, sizeof(chat_ids_copy), "%s", TELEGRAM_CHAT_IDS);
 
-    const char *token = strtok(chat_ids_copy, ",");
-    int index = 0;
+    chat_directory_clear(&app_config.chat_ids);
+    char *token = strtok(chat_ids_copy, ",");
 
-    while (token && index < MAX_CHAT_IDS) {
+    while (token) {
         char *colon = strchr(token, ':');
         if (colon) {
             *colon = '\0';  // Split name and ID
-            snprintf(app_config.chat_ids[index].first_name, CHAT_NAME_LENGTH, "%s", token);
-            snprintf(app_config.chat_ids[index].chat_id, CHAT_ID_LENGTH, "%s", colon + 1);
+            config_set_chat_id(token, colon + 1);
         } else {
             // If no name is provided, use empty string for name
-            app_config.chat_ids[index].first_name[0] = '\0';
-            strncpy(app_config.chat_ids[index].chat_id, token, CHAT_ID_LENGTH);
+            config_set_chat_id("", token);
         }
 
         token = strtok(NULL, ",");
-        index++;
     }
 }
 
+void config_init(void) {
+    // Load the configuration stored in flash, so changes made at runtime survive a reboot without any network
+    // round trip. Without a valid record, e.g. after flashing a build with a new config.ini, the defaults are used.
+    config_store_init();
+    if (!config_store_load()) {
+        config_set_defaults();
+    }
+    config_set_sample_batch_size(app_config.sample_batch_size);  // The buffer size may differ from the stored one
+    mem_report_use(MEM_BUFFER_CHATS, app_config.chat_ids.count);
+    mem_report_use(MEM_BUFFER_CHAT_NAMES, app_config.chat_ids.pool_used);
+    config_ready = true;
+}
+
 //############################################################
 //########################## SETTER ##########################
 //############################################################
 
-void config_set_notification_interval(const int interval) {
+int config_set_notification_interval(const int interval) {
+    // A longer interval would overflow the cycle in milliseconds and result in a short cycle
+    if (interval < 1 || interval > (int)CONFIG_INTERVAL_MAX) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
     app_config.temperature_notification_interval = interval;
+    config_changed();
+    // Apply the new interval immediately instead of after the current sleep
+    scheduler_reschedule();
+    return CONFIG_SUCCESS;
 }
 
 void config_set_led_feedback(const bool toggle) {
     app_config.enable_led_feedback = toggle;
+    config_changed();
+}
+
+void config_set_sample_batch_size(const int size) {
+    if (size < 1) {
+        app_config.sample_batch_size = 1;
+    } else if (size > SAMPLE_BUFFER_SIZE) {
+        app_config.sample_batch_size = SAMPLE_BUFFER_SIZE;
+    } else {
+        app_config.sample_batch_size = size;
+    }
+    config_changed();
+}
+
+int config_set_sample_max_age(const int age) {
+    // Same limit as the interval, the age in milliseconds has to fit into 32 bits and the store keeps it in 16 bits
+    if (age < 1 || age > (int)CONFIG_INTERVAL_MAX) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    app_config.sample_max_age = age;
+    config_changed();
+    return CONFIG_SUCCESS;
+}
+
+int config_set_report_deadband(const int deadband) {
+    // The config store keeps the deadband in 16 bits, a negative one would report every reading
+    if (deadband < 0 || deadband > INT16_MAX) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    app_config.report_deadband = deadband;
+    config_changed();
+    return CONFIG_SUCCESS;
+}
+
+int config_set_report_heartbeat(const int heartbeat) {
+    // The config store keeps the heartbeat in 16 bits
+    if (heartbeat < 0 || heartbeat > UINT16_MAX) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    app_config.report_heartbeat = heartbeat;
+    config_changed();
+    return CONFIG_SUCCESS;
+}
+
+void config_set_request_encoding(const request_encoding_t encoding) {
+    app_config.request_encoding = encoding;
+    endpoint_revision++;
+    config_changed();
 }
 
 void config_set_bot_token(const char *token) {
     snprintf(app_config.bot_token, BOT_TOKEN_LENGTH, "%s", token);
+    config_revision++;
+    config_changed();
 }
 
-void config_set_chat_id(const char *name, const char *id) {
-    if (!name || !id) {
+int config_set_chat_id(const char *name, const char *id) {
+    int64_t chat_id;
+    if (!name || !id || !chat_directory_parse_id(id, &chat_id)) {
         handle_error(__func__, ERROR_INVALID_ARGUMENT);
-        return;
+        return ERROR_INVALID_ARGUMENT;
     }
 
-    // Check if the id or name already exists and update it
-    for (int i = 0; i < MAX_CHAT_IDS; i++) {
-        if (strcmp(app_config.chat_ids[i].first_name, name) == 0) {
-            snprintf(app_config.chat_ids[i].chat_id, CHAT_ID_LENGTH, "%s", id);
-            return;
-        }
-        if (strcmp(app_config.chat_ids[i].chat_id, id) == 0) {
-            snprintf(app_config.chat_ids[i].first_name, CHAT_NAME_LENGTH, "%s", name);
-            return;
+    const int res = chat_directory_set(&app_config.chat_ids, name, chat_id);
+    mem_report_use(MEM_BUFFER_CHATS, app_config.chat_ids.count);
+    mem_report_use(MEM_BUFFER_CHAT_NAMES, app_config.chat_ids.pool_used);
+    chats_changed();
+    return res;
+}
+
+int config_set_chat_schedule(const char *id_or_name, const chat_schedule_t *schedule) {
+    if (!id_or_name || !schedule || (schedule->quiet_start != CHAT_QUIET_NONE && schedule->quiet_start >= 1440)
+        || (schedule->quiet_end != CHAT_QUIET_NONE && schedule->quiet_end >= 1440)) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    const int res = chat_directory_set_schedule(&app_config.chat_ids, id_or_name, schedule);
+    if (res == CONFIG_SUCCESS) {
+        chats_changed();
+    }
+    return res;
+}
+
+// Find the rule of a channel and kind, -1 if there is none
+static int alert_rule_find(const uint8_t channel, const alert_kind_t kind) {
+    for (uint8_t i = 0; i < app_config.alert_rule_count; i++) {
+        if (app_config.alert_rules[i].channel == channel && app_config.alert_rules[i].kind == kind) {
+            return i;
         }
     }
+    return -1;
+}
+
+int config_set_alert_rule(const alert_rule_t *rule) {
+    // A rate limit of 0 would fire on every change, hysteresis larger than a rate limit would never re-arm
+    if (!rule || rule->kind >= ALERT_KIND_COUNT || rule->channel >= SENSORS_MAX_CHANNELS || rule->hysteresis < 0
+        || ((rule->kind == ALERT_RISE || rule->kind == ALERT_FALL)
+            && (rule->limit <= 0 || rule->hysteresis > rule->limit))) {
+        handle_error(__func__, ERROR_ALERT_RULE);
+        return ERROR_ALERT_RULE;
+    }
 
-    // If not found, add a new entry in the first empty slot
-    for (int i = 0; i < MAX_CHAT_IDS; i++) {
-        if (strlen(app_config.chat_ids[i].chat_id) == 0) {  // Empty slot found
-            snprintf(app_config.chat_ids[i].first_name, CHAT_NAME_LENGTH, "%s", name);
-            snprintf(app_config.chat_ids[i].chat_id, CHAT_ID_LENGTH, "%s", id);
-            return;
+    int index = alert_rule_find(rule->channel, rule->kind);
+    if (index < 0) {
+        if (app_config.alert_rule_count >= ALERT_MAX_RULES) {
+            handle_error(__func__, ERROR_ALERT_RULE);
+            return ERROR_ALERT_RULE;
         }
+        index = app_config.alert_rule_count++;
     }
+    app_config.alert_rules[index] = *rule;
+    alert_rules_changed();
+    config_changed();
+    return CONFIG_SUCCESS;
 }
 
 void config_set_telegram_url(const char *url) {
     snprintf(app_config.telegram_url, URL_LENGTH, "%s", url);
+    config_revision++;
+    config_changed();
 }
 
 void config_set_address(const char *address) {
     snprintf(app_config.address, ADDRESS_LENGTH, "%s", address);
+    endpoint_revision++;
+    config_changed();
 }
 
 void config_set_port(const char *port) {
     snprintf(app_config.port, PORT_LENGTH, "%s", port);
+    endpoint_revision++;
+    config_changed();
 }
 
 void config_set_uri_path(const char *path) {
     snprintf(app_config.uri_path, URI_PATH_LENGTH, "%s", path);
+    endpoint_revision++;
+    config_changed();
 }
 
 //############################################################
@@ -117,41 +261,72 @@ bool config_get_led_feedback(void) {
     return app_config.enable_led_feedback;
 }
 
+uint8_t config_get_sample_batch_size(void) {
+    return app_config.sample_batch_size;
+}
+
+int config_get_sample_max_age(void) {
+    return app_config.sample_max_age;
+}
+
+int config_get_report_deadband(void) {
+    return app_config.report_deadband;
+}
+
+int config_get_report_heartbeat(void) {
+    return app_config.report_heartbeat;
+}
+
+request_encoding_t config_get_request_encoding(void) {
+    return app_config.request_encoding;
+}
+
 const char* config_get_bot_token(void) {
     return app_config.bot_token;
 }
 
-const char* config_get_chat_id(const int index) {
-    if (index < 0 || index >= MAX_CHAT_IDS) {
+chat_index_t config_get_chat_count(void) {
+    return app_config.chat_ids.count;
+}
+
+const char* config_get_chat_name(const int index) {
+    if (index < 0 || index >= app_config.chat_ids.count) {
         return NULL; // Prevent out-of-bounds access
     }
-    return app_config.chat_ids[index].chat_id;
+    return chat_directory_name(&app_config.chat_ids, index);
 }
 
-const char* config_get_chat_id_by_name(const char *name) {
-    for (int i = 0; i < MAX_CHAT_IDS; i++) {
-        if (strcmp(app_config.chat_ids[i].first_name, name) == 0) {
-            return app_config.chat_ids[i].chat_id;
-        }
-    }
-    return NULL;
+const int64_t* config_get_chat_id_by_name(const char *name) {
+    return chat_directory_find_by_name(&app_config.chat_ids, name);
 }
 
-const char* config_get_chat_ids_string(void) {
-    static char chat_ids_str[MAX_CHAT_IDS * (CHAT_ID_LENGTH + 2)];
-    chat_ids_str[0] = '\0';
+int config_find_chat(const char *id_or_name) {
+    return chat_directory_find(&app_config.chat_ids, id_or_name);
+}
 
-    for (int i = 0; i < MAX_CHAT_IDS; i++) {
-        if (strlen(app_config.chat_ids[i].chat_id) > 0) {
-            if (strlen(chat_ids_str) > 0) {
-                strcat(chat_ids_str, ",");
-            }
-            strcat(chat_ids_str, app_config.chat_ids[i].chat_id);
-        }
+int config_find_chat_id(const int64_t id) {
+    return chat_directory_find_id(&app_config.chat_ids, id);
+}
+
+const int64_t* config_get_chat_ids(void) {
+    return app_config.chat_ids.ids;
+}
+
+
+const chat_schedule_t* config_get_chat_schedule(const int index) {
+    if (index < 0 || index >= app_config.chat_ids.count) {
+        return NULL;
     }
-    return chat_ids_str;
+    return chat_directory_schedule(&app_config.chat_ids, index);
 }
 
+uint8_t config_get_alert_rule_count(void) {
+    return app_config.alert_rule_count;
+}
+
+const alert_rule_t* config_get_alert_rules(void) {
+    return app_config.alert_rules;
+}
 
 const char* config_get_telegram_url(void) {
     return app_config.telegram_url;
@@ -169,20 +344,36 @@ const char* config_get_uri_path(void) {
     return app_config.uri_path;
 }
 
+uint16_t config_get_endpoint_revision(void) {
+    return endpoint_revision;
+}
+
+uint16_t config_get_revision(void) {
+    // Only a real change of the chat list changes the revision of the directory
+    return config_revision + app_config.chat_ids.revision;
+}
+
 // Remove chat entries by ID or username
-void config_remove_chat_by_id_or_name(const char *id_or_name) {
-    if (!id_or_name) return;
-
-    for (int i = 0; i < MAX_CHAT_IDS; i++) {
-        if (strcmp(app_config.chat_ids[i].first_name, id_or_name) == 0) {
-            app_config.chat_ids[i].first_name[0] = '\0';
-            app_config.chat_ids[i].chat_id[0] = '\0';
-            return;
-        }
-        if (strcmp(app_config.chat_ids[i].chat_id, id_or_name) == 0) {
-            app_config.chat_ids[i].first_name[0] = '\0';
-            app_config.chat_ids[i].chat_id[0] = '\0';
-            return;
-        }
+int config_remove_chat_by_id_or_name(const char *id_or_name) {
+    if (!id_or_name || !chat_directory_remove(&app_config.chat_ids, id_or_name)) {
+        handle_error(__func__, ERROR_CHAT_ID_NOT_FOUND);
+        return ERROR_CHAT_ID_NOT_FOUND;
+    }
+    chats_changed();
+    return CONFIG_SUCCESS;
+}
+
+int config_remove_alert_rule(const uint8_t channel, const alert_kind_t kind) {
+    const int index = alert_rule_find(channel, kind);
+    if (index < 0) {
+        handle_error(__func__, ERROR_ALERT_RULE);
+        return ERROR_ALERT_RULE;
     }
+    // Keep the order of the remaining rules
+    memmove(&app_config.alert_rules[index], &app_config.alert_rules[index + 1],
+            (app_config.alert_rule_count - index - 1) * sizeof(alert_rule_t));
+    app_config.alert_rule_count--;
+    alert_rules_changed();
+    config_changed();
+    return CONFIG_SUCCESS;
 }
@@ -6,16 +6,19 @@
 #define CONFIGURATION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "config_constants.h"
+#include "chat_directory.h"
+#include "alert.h"
 
 /**
- * Struct for telegram chats
+ * Encoding of the CoAP request payloads
  */
-typedef struct {
-    char first_name[CHAT_NAME_LENGTH];              /**< First name of the person associated with a chat */
-    char chat_id[CHAT_ID_LENGTH];                   /**< Chat id of a chat */
-} chat_entry_t;
+typedef enum {
+    REQUEST_ENCODING_TEXT,                          /**< Form string "url=...&token=...&..." */
+    REQUEST_ENCODING_CBOR                           /**< CBOR map with integer keys */
+} request_encoding_t;
 
 /**
  * Struct for configuration settings
@@ -23,8 +26,15 @@ typedef struct {
 typedef struct {
     int temperature_notification_interval;          /**< Notification interval */
     bool enable_led_feedback;                       /**< Led Feedback toggle */
+    uint8_t sample_batch_size;                      /**< Number of samples sent in one notification */
+    int sample_max_age;                             /**< Maximum age of the oldest sample before sending */
+    request_encoding_t request_encoding;            /**< Encoding of the CoAP request payloads */
+    int report_deadband;                            /**< Minimum change (in 0.01 units) to report a reading */
+    int report_heartbeat;                           /**< Number of intervals after which a reading is always reported */
     char bot_token[BOT_TOKEN_LENGTH];               /**< Telegram bot token */
-    chat_entry_t chat_ids[MAX_CHAT_IDS];            /**< Telegram chat ids */
+    chat_directory_t chat_ids;                      /**< Telegram chat ids and names */
+    alert_rule_t alert_rules[ALERT_MAX_RULES];      /**< Alert rules, at most one per channel and kind */
+    uint8_t alert_rule_count;                       /**< Number of alert rules */
     char telegram_url[URL_LENGTH];                  /**< Telegram API URL */
     char address[ADDRESS_LENGTH];                   /**< CoAP server IPv6 address */
     char port[PORT_LENGTH];                         /**< CoAP server port */
@@ -45,11 +55,18 @@ void config_init(void);
 //########################## SETTER ##########################
 //############################################################
 
+/**
+ * Longest notification interval in minutes (INTERVAL_UNIT): the cycle in milliseconds has to fit into 32 bits, and the
+ * config store keeps the interval in 16 bits
+ */
+#define CONFIG_INTERVAL_MAX (UINT32_MAX / INTERVAL_UNIT < UINT16_MAX ? UINT32_MAX / INTERVAL_UNIT : UINT16_MAX)
+
 /**
  * Set the temperature notification interval.
- * @param interval Interval in minutes.
+ * @param interval Interval in minutes, 1 to CONFIG_INTERVAL_MAX.
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT if the interval is out of range.
  */
-void config_set_notification_interval(int interval);
+int config_set_notification_interval(int interval);
 
 /**
  * Toggle the LED Feedback on the board for CoAP requests.
@@ -57,6 +74,40 @@ void config_set_notification_interval(int interval);
  */
 void config_set_led_feedback(bool toggle);
 
+/**
+ * Set the number of samples which are collected before they are sent in one notification.
+ * @param size Number of samples, limited to SAMPLE_BUFFER_SIZE.
+ */
+void config_set_sample_batch_size(int size);
+
+/**
+ * Set the maximum age of the oldest collected sample, after which the samples are sent regardless of the batch size.
+ * @param age Age in minutes, 1 to CONFIG_INTERVAL_MAX.
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT if the age is out of range.
+ */
+int config_set_sample_max_age(int age);
+
+/**
+ * Set the deadband of the change-driven reporting.
+ * @param deadband Minimum change in hundredths of a unit (e.g. 50 = 0.5 °C), 0 reports every reading, up to INT16_MAX.
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT if the deadband is out of range.
+ */
+int config_set_report_deadband(int deadband);
+
+/**
+ * Set the heartbeat of the change-driven reporting.
+ * @param heartbeat Number of intervals after which a reading is reported regardless of the deadband, 0 disables it,
+ * up to UINT16_MAX.
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT if the heartbeat is out of range.
+ */
+int config_set_report_heartbeat(int heartbeat);
+
+/**
+ * Set the encoding of the CoAP request payloads.
+ * @param encoding Either form string (REQUEST_ENCODING_TEXT) or CBOR (REQUEST_ENCODING_CBOR).
+ */
+void config_set_request_encoding(request_encoding_t encoding);
+
 /**
  * Change to telegram bot token. *
  * @param token Telegram bot token.
@@ -69,8 +120,24 @@ void config_set_bot_token(const char *token);
  * - If no match is found, a new entry is created.
  * @param name - The username of the chat.
  * @param id - The ID of the chat.
+ * @return Custom codes defined in error_handler.h.
+ */
+int config_set_chat_id(const char *name, const char *id);
+
+/**
+ * Change the notification schedule of a chat.
+ * @param id_or_name Either ID or username.
+ * @param schedule Interval in minutes (0 = with the batches) and quiet window in minutes of the day.
+ * @return CONFIG_SUCCESS, ERROR_INVALID_ARGUMENT for a quiet window beyond the day or ERROR_CHAT_ID_NOT_FOUND.
+ */
+int config_set_chat_schedule(const char *id_or_name, const chat_schedule_t *schedule);
+
+/**
+ * Add an alert rule, or replace the rule of the same channel and kind.
+ * @param rule The rule, limit and hysteresis in hundredths of a unit (per minute for rates).
+ * @return CONFIG_SUCCESS or ERROR_ALERT_RULE if the rule is invalid or there is no space left.
  */
-void config_set_chat_id(const char *name, const char *id);
+int config_set_alert_rule(const alert_rule_t *rule);
 
 /**
  * Change the default telegram bot URL.
@@ -112,6 +179,36 @@ int config_get_notification_interval(void);
  */
 bool config_get_led_feedback(void);
 
+/**
+ * Get the number of samples sent in one notification.
+ * @return Number of samples.
+ */
+uint8_t config_get_sample_batch_size(void);
+
+/**
+ * Get the maximum age of the oldest collected sample.
+ * @return Age in minutes.
+ */
+int config_get_sample_max_age(void);
+
+/**
+ * Get the deadband of the change-driven reporting.
+ * @return Minimum change in hundredths of a unit.
+ */
+int config_get_report_deadband(void);
+
+/**
+ * Get the heartbeat of the change-driven reporting.
+ * @return Number of intervals.
+ */
+int config_get_report_heartbeat(void);
+
+/**
+ * Get the encoding of the CoAP request payloads.
+ * @return Either form string (REQUEST_ENCODING_TEXT) or CBOR (REQUEST_ENCODING_CBOR).
+ */
+request_encoding_t config_get_request_encoding(void);
+
 /**
  * Get the telegram bot token configuration.
  * @return Telegram bot token.
@@ -119,24 +216,64 @@ bool config_get_led_feedback(void);
 const char* config_get_bot_token(void);
 
 /**
- * Get a chat ID by its index in chat_ids.
- * @param index Index of the ID.
- * @return Chat ID.
+ * Get the number of chats currently saved in chat_ids.
+ * @return Number of chats.
  */
-const char* config_get_chat_id(int index);
+chat_index_t config_get_chat_count(void);
+
+/**
+ * Get a chat name by its position in chat_ids.
+ * @param index Position of the chat.
+ * @return Name of the chat, empty if it has none, NULL if the position is out of range.
+ */
+const char* config_get_chat_name(int index);
 
 /**
  * Get a chat ID by tha associated username.
  * @param name The username.
- * @return Chat ID.
+ * @return Pointer to the chat ID, NULL if the name is unknown.
+ */
+const int64_t* config_get_chat_id_by_name(const char *name);
+
+/**
+ * Get the position of a chat in chat_ids by its name or its ID.
+ * @param id_or_name Name of the chat or its ID as decimal string.
+ * @return Position of the chat, -1 if there is no such chat.
+ */
+int config_find_chat(const char *id_or_name);
+
+/**
+ * Get the position of a chat in chat_ids by its ID.
+ * @param id ID of the chat.
+ * @return Position of the chat, -1 if the ID is unknown.
+ */
+int config_find_chat_id(int64_t id);
+
+/**
+ * Get all chat IDs currently saved in chat_ids, sorted in ascending order. The list is kept up to date by the setters
+ * and is not rebuilt when reading it.
+ * @return Array of config_get_chat_count() chat IDs.
+ */
+const int64_t* config_get_chat_ids(void);
+
+/**
+ * Get the notification schedule of a chat by its position in chat_ids.
+ * @param index Position of the chat.
+ * @return Pointer to the schedule, NULL if the position is out of range.
  */
-const char* config_get_chat_id_by_name(const char *name);
+const chat_schedule_t* config_get_chat_schedule(int index);
 
 /**
- * Get all chat IDs from the chat entries currently saved in chat_ids.
- * @return Comma seperated chat IDs.
+ * Get the number of alert rules.
+ * @return Number of rules.
  */
-const char* config_get_chat_ids_string(void);
+uint8_t config_get_alert_rule_count(void);
+
+/**
+ * Get all alert rules.
+ * @return Array of config_get_alert_rule_count() rules.
+ */
+const alert_rule_t* config_get_alert_rules(void);
 
 /**
  * Get the telegram bot URL configuration.
@@ -162,6 +299,20 @@ const char* config_get_port(void);
  */
 const char* config_get_uri_path(void);
 
+/**
+ * Get the revision of the telegram credentials and the chat list.
+ * The revision changes whenever one of them is modified.
+ * @return Configuration revision.
+ */
+uint16_t config_get_revision(void);
+
+/**
+ * Get the revision of the CoAP endpoint: address, port, URI path and request encoding.
+ * The revision changes whenever one of them is modified, which invalidates the cached request templates.
+ * @return Endpoint revision.
+ */
+uint16_t config_get_endpoint_revision(void);
+
 //############################################################
 //######################### REMOVER ##########################
 //############################################################
@@ -169,7 +320,16 @@ const char* config_get_uri_path(void);
 /**
  * Remove a chat entry from the configuration.
  * @param id_or_name Either ID or username.
+ * @return CONFIG_SUCCESS or ERROR_CHAT_ID_NOT_FOUND if there is no such chat.
+ */
+int config_remove_chat_by_id_or_name(const char *id_or_name);
+
+/**
+ * Remove the alert rule of a channel and kind.
+ * @param channel Channel of the rule.
+ * @param kind Condition of the rule.
+ * @return CONFIG_SUCCESS or ERROR_ALERT_RULE if there is no such rule.
  */
-void config_remove_chat_by_id_or_name(const char *id_or_name);
+int config_remove_alert_rule(uint8_t channel, alert_kind_t kind);
 
 #endif //CONFIGURATION_H
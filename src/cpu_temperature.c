@@ -10,6 +10,8 @@
 #include "ztimer.h"
 
 #include "cpu_temperature.h"
+#include "sensors.h"
+#include "aggregate.h"
 #include "utils/timestamp_convert.h"
 #include "utils/error_handler.h"
 
@@ -39,6 +41,9 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
         return ERROR_NULL_POINTER;
     }
     cpu_temp->temperature = 0;
+    cpu_temp->min = 0;
+    cpu_temp->max = 0;
+    cpu_temp->count = 1;
     cpu_temp->scale = 0;
     cpu_temp->unit = 0;
     snprintf(cpu_temp->device_name, DEVICE_NAME_MAX_LEN, "%s", "Unknown");
@@ -48,6 +53,8 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
 #ifdef BOARD_NATIVE
     // Mock temperature data for the native platform
     cpu_temp->temperature = 2500; // Mock values for 25.00°C
+    cpu_temp->min = cpu_temp->temperature;
+    cpu_temp->max = cpu_temp->temperature;
     cpu_temp->scale = -2;
     cpu_temp->unit = UNIT_TEMP_C;
     snprintf(cpu_temp->device_name, DEVICE_NAME_MAX_LEN, "%s", "Mock-Sensor");
@@ -55,9 +62,7 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
     cpu_temp->status = 0;
 #else
     phydat_t data;
-    saul_reg_t *device = saul_reg_find_type(SAUL_SENSE_TEMP);
-
-    saul_reg_t *device = saul_reg_find_type(SAUL_SENSE_TEMP);
+    saul_reg_t *device = sensors_find(SAUL_SENSE_TEMP);  // Cached by sensors_init(), no registry search
 
     // Check device correctness
     if (device == NULL) {
@@ -69,7 +74,7 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
     snprintf(cpu_temp->device_name, DEVICE_NAME_MAX_LEN, "%s", device->name);
 
     // Read data from a device
-    cpu_temp->timestamp = ztimer_now(ZTIMER_USEC);
+    cpu_temp->timestamp = ztimer_now(ZTIMER_MSEC);
     if (saul_reg_read(device, &data) < 0) {
         cpu_temp->status = ERROR_TEMP_READ_FAIL;
         handle_error(__func__,ERROR_TEMP_READ_FAIL);
@@ -77,6 +82,8 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
     }
 
     cpu_temp->temperature = data.val[0];
+    cpu_temp->min = data.val[0];
+    cpu_temp->max = data.val[0];
     cpu_temp->scale = data.scale;
     cpu_temp->unit = data.unit;
     cpu_temp->status = 0;
@@ -86,6 +93,35 @@ int cpu_temperature_get(cpu_temperature_t *cpu_temp) {
     return TEMP_SUCCESS;
 }
 
+// Fill the struct with the summary of the window of the first temperature channel
+bool cpu_temperature_window(cpu_temperature_t *cpu_temp) {
+    if (!cpu_temp) { // Null pointer
+        handle_error(__func__,ERROR_NULL_POINTER);
+        return false;
+    }
+
+    for (uint8_t channel = 0; channel < sensors_count(); channel++) {
+        if (sensors_channel(channel)->type != SAUL_SENSE_TEMP) {
+            continue;
+        }
+        sensor_reading_t summary;
+        if (!aggregate_peek(channel, &summary)) {
+            return false;
+        }
+        cpu_temp->temperature = summary.value;
+        cpu_temp->min = summary.min;
+        cpu_temp->max = summary.max;
+        cpu_temp->count = summary.count;
+        cpu_temp->scale = summary.scale;
+        cpu_temp->unit = summary.unit;
+        sensors_name(channel, cpu_temp->device_name, DEVICE_NAME_MAX_LEN);
+        cpu_temp->timestamp = ztimer_now(ZTIMER_MSEC);
+        cpu_temp->status = 0;
+        return true;
+    }
+    return false;
+}
+
 // Small helper function to determine the divisor
 int determine_divisor(const int8_t scale) {
     int divisor = 1;
@@ -95,6 +131,17 @@ int determine_divisor(const int8_t scale) {
     return divisor;
 }
 
+// Write a raw value with the decimal places of its scale, e.g. -205 (scale -2) -> "-2.05"
+static int format_value(char *buffer, const size_t buffer_size, const int16_t value, const int8_t scale) {
+    const int divisor = determine_divisor(scale);
+    const int magnitude = value < 0 ? -value : value;
+    if (divisor == 1) {
+        return snprintf(buffer, buffer_size, "%d", value);
+    }
+    return snprintf(buffer, buffer_size, "%s%d.%0*d", value < 0 ? "-" : "", magnitude / divisor, -scale,
+                    magnitude % divisor);
+}
+
 // Print the CPU temperature
 void cpu_temperature_formatter(const cpu_temperature_t *cpu_temp, const caller_class_t caller_class, char *buffer, const size_t buffer_size) {
     char time_str[9];
@@ -128,6 +175,16 @@ void cpu_temperature_formatter(const cpu_temperature_t *cpu_temp, const caller_c
                         device_name, integer_part, (cpu_temp->scale < 0 ? -cpu_temp->scale : 0),
                         fractional_part, unit_to_string(cpu_temp->unit));
                 break;
+            case CALL_FROM_CLASS_AGGREGATE: {
+                // Print the statistics of an oversampling window
+                char mean[8], min[8], max[8];
+                format_value(mean, sizeof(mean), cpu_temp->temperature, cpu_temp->scale);
+                format_value(min, sizeof(min), cpu_temp->min, cpu_temp->scale);
+                format_value(max, sizeof(max), cpu_temp->max, cpu_temp->scale);
+                snprintf(buffer, buffer_size, "[%s] %s Temperature: %s %s (min %s, max %s, %u readings)\n",
+                        time_str, device_name, mean, unit_to_string(cpu_temp->unit), min, max, cpu_temp->count);
+                break;
+            }
             default:
                 handle_error(__func__, ERROR_CALLER_UNKNOWN);
         }
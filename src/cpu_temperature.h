@@ -6,8 +6,7 @@
 #define CPU_TEMPERATURE_H
 
 #include "config_constants.h"
-
-#define DEVICE_NAME_MAX_LEN 32
+#include "sensors.h"
 
 # define CLASS_CMD_BUFFER_SIZE 120
 # define CLASS_COAP_BUFFER_SIZE MESSAGE_DATA_LENGTH
@@ -24,11 +23,14 @@ typedef struct {
  * Store the cpu temperature and more meta information
  */
 typedef struct {
-    int16_t temperature;                        /**< CPU temperature reading */
+    int16_t temperature;                        /**< CPU temperature reading, the mean of a window */
+    int16_t min;                                /**< Lowest temperature of a window */
+    int16_t max;                                /**< Highest temperature of a window */
+    uint16_t count;                             /**< Number of readings of a window, 1 for a single reading */
     int8_t scale;                               /**< Scale of measurement (10^scale) */
     uint8_t unit;                               /**< Unit of the measurement */
     char device_name[DEVICE_NAME_MAX_LEN];      /**< Device name */
-    uint32_t timestamp;                         /**< Time of the reading in microseconds */
+    uint32_t timestamp;                         /**< Time of the reading in milliseconds */
     int8_t status;                              /**< Custom codes defined in error_handler.h */
 } cpu_temperature_t;
 
@@ -37,7 +39,8 @@ typedef struct {
  */
 typedef enum {
     CALL_FROM_CLASS_CMD,
-    CALL_FROM_CLASS_COAP
+    CALL_FROM_CLASS_COAP,
+    CALL_FROM_CLASS_AGGREGATE
 } caller_class_t;
 
 /**
@@ -47,6 +50,27 @@ typedef enum {
  */
 int cpu_temperature_get(cpu_temperature_t *cpu_temp);
 
+/**
+ * Get the statistics of the current oversampling window of the temperature channel, without closing the window
+ * @param cpu_temp Pointer to a cpu_temperature_t struct receiving mean, min, max and count
+ * @return Whether the window contains any reading
+ */
+bool cpu_temperature_window(cpu_temperature_t *cpu_temp);
+
+/**
+ * Get the divisor of a scale, which splits a raw reading into integer and fractional part (e.g. -2 -> 100)
+ * @param scale Scale of measurement (10^scale)
+ * @return The divisor
+ */
+int determine_divisor(int8_t scale);
+
+/**
+ * Get the string of a temperature unit
+ * @param unit The unit (phydat_t)
+ * @return The unit string, "undefined" for unknown units
+ */
+const char *unit_to_string(uint8_t unit);
+
 /**
  * Formats the CPU temperature struct into a 'nice' string depending on the caller class
  * @param cpu_temp Pointer to a cpu_temperature_t struct
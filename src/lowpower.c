@@ -0,0 +1,127 @@
+//
+// Created by vincent on 3/28/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "irq.h"
+#include "mutex.h"
+#include "ztimer.h"
+#include "net/netif.h"
+#include "net/gnrc/netif.h"
+
+#ifdef MODULE_GNRC_RPL
+#include "net/gnrc/rpl.h"
+#include "net/gnrc/rpl/dodag.h"
+#endif
+
+#include "lowpower.h"
+#include "config_constants.h"
+#include "utils/error_handler.h"
+
+// The radio is awake after the boot, the CoAP thread needs it for the startup
+static lowpower_t lowpower = { .radio_users = 1 << LOWPOWER_RADIO_COAP };
+static mutex_t radio_lock = MUTEX_INIT;         // The radio is switched by the CoAP and the console thread
+
+static const char *wakeup_names[LOWPOWER_WAKEUP_COUNT] = {
+    "cycle", "subsample", "retry", "startup", "control", "notification", "schedule"
+};
+
+void lowpower_wakeup(const lowpower_wakeup_t cause) {
+    // Counted by the CoAP and the gcoap thread
+    const unsigned state = irq_disable();
+    lowpower.wakeups[cause]++;
+    irq_restore(state);
+}
+
+// Set the state of the radio of the first interface, the tap interface of the native board has no radio to switch
+static void radio_set_state(netopt_state_t state) {
+#ifdef BOARD_NATIVE
+    (void)state;
+#else
+    gnrc_netif_t *netif = gnrc_netif_iter(NULL);
+    if (!netif || netif_set_opt(&netif->netif, NETOPT_STATE, 0, &state, sizeof(state)) < 0) {
+        handle_error(__func__, ERROR_RADIO_STATE);
+    }
+#endif
+}
+
+// Stop routing for other nodes: a leaf joins the DODAG of its parent but sends no DIOs itself
+static void rpl_leaf_operation(void) {
+#ifdef MODULE_GNRC_RPL
+    for (uint8_t i = 0; i < GNRC_RPL_INSTANCES_NUMOF; i++) {
+        gnrc_rpl_instance_t *instance = &gnrc_rpl_instances[i];
+        if (instance->state != 0 && instance->dodag.node_status != GNRC_RPL_LEAF_NODE) {
+            gnrc_rpl_leaf_operation(&instance->dodag);
+        }
+    }
+#endif
+}
+
+void lowpower_radio_wake(const lowpower_radio_user_t user) {
+    if (ENABLE_LOW_POWER != 1) {
+        return;
+    }
+    mutex_lock(&radio_lock);
+    rpl_leaf_operation();
+    lowpower.radio_users |= 1 << user;
+    if (lowpower.radio_asleep) {
+        radio_set_state(NETOPT_STATE_IDLE);
+        const uint32_t now = ztimer_now(ZTIMER_MSEC);
+        lowpower.radio_asleep_ms += now - lowpower.radio_changed;
+        lowpower.radio_changed = now;
+        lowpower.radio_asleep = false;
+    }
+    mutex_unlock(&radio_lock);
+}
+
+void lowpower_radio_sleep(const lowpower_radio_user_t user) {
+    if (ENABLE_LOW_POWER != 1) {
+        return;
+    }
+    // A request of the other user may still be in flight, the last user puts the radio to sleep
+    mutex_lock(&radio_lock);
+    lowpower.radio_users &= ~(1 << user);
+    if (lowpower.radio_users == 0 && !lowpower.radio_asleep) {
+        radio_set_state(NETOPT_STATE_SLEEP);
+        lowpower.radio_changed = ztimer_now(ZTIMER_MSEC);
+        lowpower.radio_sleeps++;
+        lowpower.radio_asleep = true;
+    }
+    mutex_unlock(&radio_lock);
+}
+
+void lowpower_print(void) {
+    const uint32_t now = ztimer_now(ZTIMER_MSEC);
+    uint32_t total = 0;
+    puts("Wake-up        count");
+    for (int i = 0; i < LOWPOWER_WAKEUP_COUNT; i++) {
+        printf("%-12s %7lu\n", wakeup_names[i], (unsigned long)lowpower.wakeups[i]);
+        total += lowpower.wakeups[i];
+    }
+    printf("%-12s %7lu\n", "total", (unsigned long)total);
+
+    if (ENABLE_LOW_POWER != 1) {
+        puts("Radio: always on (low_power = 0).");
+        return;
+    }
+    mutex_lock(&radio_lock);
+    const lowpower_t radio = lowpower;
+    mutex_unlock(&radio_lock);
+    const uint32_t asleep = radio.radio_asleep_ms + (radio.radio_asleep ? now - radio.radio_changed : 0);
+    printf("Radio: %s, asleep %lu of %lu s, put to sleep %u times.\n", radio.radio_asleep ? "asleep" : "awake",
+        (unsigned long)(asleep / 1000), (unsigned long)((now - radio.since) / 1000), radio.radio_sleeps);
+}
+
+void lowpower_reset(void) {
+    const unsigned state = irq_disable();
+    memset(lowpower.wakeups, 0, sizeof(lowpower.wakeups));
+    irq_restore(state);
+    mutex_lock(&radio_lock);
+    lowpower.since = ztimer_now(ZTIMER_MSEC);
+    lowpower.radio_changed = lowpower.since;
+    lowpower.radio_asleep_ms = 0;
+    lowpower.radio_sleeps = 0;
+    mutex_unlock(&radio_lock);
+}
@@ -0,0 +1,75 @@
+//
+// Created by vincent on 3/28/25.
+//
+
+#ifndef LOWPOWER_H
+#define LOWPOWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Causes of a wake-up of the CoAP thread
+ */
+typedef enum {
+    LOWPOWER_WAKEUP_CYCLE = 0,                  /**< Periodic notification cycle */
+    LOWPOWER_WAKEUP_SUBSAMPLE,                  /**< Reading between two cycles (oversampling) */
+    LOWPOWER_WAKEUP_RETRY,                      /**< Backoff retry of undelivered samples */
+    LOWPOWER_WAKEUP_STARTUP,                    /**< Network ready or registration attempt at startup */
+    LOWPOWER_WAKEUP_CONTROL,                    /**< Event posted by the shell or the websocket, e.g. a new interval */
+    LOWPOWER_WAKEUP_NOTIFICATION,               /**< Configuration pushed by the websocket (observe) */
+    LOWPOWER_WAKEUP_SCHEDULE,                   /**< Readings due for chats with their own schedule */
+    LOWPOWER_WAKEUP_COUNT
+} lowpower_wakeup_t;
+
+/**
+ * Users of the radio, it only sleeps once no user needs it anymore
+ */
+typedef enum {
+    LOWPOWER_RADIO_COAP = 0,                    /**< CoAP thread: reports, retries, alerts and schedules */
+    LOWPOWER_RADIO_SHELL,                       /**< Console thread: coap-test and coap-update */
+} lowpower_radio_user_t;
+
+/**
+ * Store the wake-up counters and the radio state
+ */
+typedef struct {
+    uint32_t wakeups[LOWPOWER_WAKEUP_COUNT];    /**< Number of wake-ups per cause */
+    uint32_t since;                             /**< Start of the accounting in milliseconds */
+    uint32_t radio_changed;                     /**< Time of the last radio state change in milliseconds */
+    uint32_t radio_asleep_ms;                   /**< Time the radio slept since the start of the accounting */
+    uint16_t radio_sleeps;                      /**< Number of times the radio was put to sleep */
+    uint8_t radio_users;                        /**< Users which need the radio, one bit per lowpower_radio_user_t */
+    bool radio_asleep;                          /**< Whether the radio is asleep */
+} lowpower_t;
+
+/**
+ * Count a wake-up. Works on every board, including native, so spurious wake-ups show up in the benchmark.
+ * @param cause Cause of the wake-up.
+ */
+void lowpower_wakeup(lowpower_wakeup_t cause);
+
+/**
+ * Wake the radio before sending and switch the RPL instances to leaf operation, which a DODAG joined since the last
+ * wake-up would not use yet. Does nothing unless ENABLE_LOW_POWER is set.
+ * @param user User which needs the radio, waking it again for the same user has no effect.
+ */
+void lowpower_radio_wake(lowpower_radio_user_t user);
+
+/**
+ * Release the radio, it is put to sleep once no other user needs it. Does nothing unless ENABLE_LOW_POWER is set.
+ * @param user User which no longer needs the radio.
+ */
+void lowpower_radio_sleep(lowpower_radio_user_t user);
+
+/**
+ * Print the wake-ups per cause and the time the radio slept.
+ */
+void lowpower_print(void);
+
+/**
+ * Reset the wake-up counters and the radio time.
+ */
+void lowpower_reset(void);
+
+#endif //LOWPOWER_H
@@ -6,14 +6,15 @@
 #include <stdlib.h>
 
 #include "msg.h"
+#include "sched.h"
 #include "thread.h"
 #include "ztimer.h"
 
-#include "led_control.h"
 #include "cmd_control.h"
 #include "configuration.h"
-#include "cpu_temperature.h"
-#include "coap_post.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "startup.h"
 #include "utils/error_handler.h"
 
 #ifdef BOARD_NATIVE
@@ -27,7 +28,6 @@ static msg_t main_msg_queue[MAIN_QUEUE_SIZE];
 static msg_t coap_msg_queue[MAIN_QUEUE_SIZE];
 
 char coap_thread_stack[THREAD_STACK_SIZE];
-char buffer_temp[CLASS_COAP_BUFFER_SIZE];
 
 #if ENABLE_CONSOLE_THREAD == 1
 static msg_t cmd_msg_queue[MAIN_QUEUE_SIZE];
@@ -38,41 +38,9 @@ void *coap_thread(void *arg) {
     (void) arg;
     msg_init_queue(coap_msg_queue, MAIN_QUEUE_SIZE);
 
-    while (1) {
-        const uint32_t start_time = ztimer_now(ZTIMER_MSEC);
-
-        memset(buffer_temp, 0, CLASS_COAP_BUFFER_SIZE);
-        cpu_temperature_t temp;
-        cpu_temperature_get(&temp);
-        cpu_temperature_formatter(&temp, CALL_FROM_CLASS_COAP, buffer_temp, CLASS_COAP_BUFFER_SIZE);
-
-        // Fetch updates from Telegram
-        const int update_res = coap_post_get_updates();
-        handle_error(__func__, update_res);
-
-        // Send CoAP message
-        const int send_res = coap_post_send(buffer_temp, "all");
-        handle_error(__func__, send_res);
-
-        if (send_res == COAP_SUCCESS) {
-            if (app_config.enable_led_feedback) {
-                led_control_execute(0, "on");
-            }
-            uint32_t wait_time = 1000;  // Max wait time
-            while (!get_coap_response_status() && wait_time > 0) {
-                ztimer_sleep(ZTIMER_MSEC, 50);
-                wait_time -= 50;
-            }
-        }
-        uint32_t elapsed_time = ztimer_now(ZTIMER_MSEC) - start_time;  // Compute elapsed time
-        printf("CoAP communication took %lu ms to finish.\n", (unsigned long)elapsed_time);
-
-        if (app_config.enable_led_feedback) {
-            led_control_execute(0, "off");
-        }
-
-        ztimer_sleep(ZTIMER_MSEC, config_get_notification_interval() * 60000);
-    }
+    // Run the notification cycle from the event queue, so interval changes apply immediately
+    scheduler_init();
+    scheduler_run();
     return NULL;
 }
 
@@ -86,28 +54,37 @@ void *console_thread(void *arg) {
 #endif
 
 int main(void) {
-    // Wait 1 second to allow for everything to load correctly
-    ztimer_sleep(ZTIMER_MSEC, 1000);
+    // Required by the startup, which waits for the global address on the netif bus
+    msg_init_queue(main_msg_queue, MAIN_QUEUE_SIZE);
+
+    // Hold the millisecond clock from the start, errors of the initialization are recorded with its time already.
+    // With ztimer_ondemand it is stopped otherwise until the timer wheel acquires it in the CoAP thread.
+    ztimer_acquire(ZTIMER_MSEC);
 
-    // Initialize the configuration
+    // Initialize the configuration, both threads use it
     config_init();
 
-    msg_init_queue(main_msg_queue, MAIN_QUEUE_SIZE);
+    // Enumerate the sensors once, the notification cycle reads the cached devices
+    sensors_init();
 
     // Thread #1: CoAP
+    // Threads: the stacks are painted at creation, which allows measuring their high-water marks (mem command)
     thread_create(coap_thread_stack, THREAD_STACK_SIZE,
-        6, 0, coap_thread, NULL, "CoapThread");
+        6, THREAD_CREATE_STACKTEST, coap_thread, NULL, "CoapThread");
 
     // Thread #2: Console
 #if ENABLE_CONSOLE_THREAD == 1
     thread_create(console_thread_stack, THREAD_STACK_SIZE,
-        7, 0, console_thread, NULL, "ConsoleThread");
+        7, THREAD_CREATE_STACKTEST, console_thread, NULL, "ConsoleThread");
 #endif
 
-    msg_t msg;
-    while (1) {
-        msg_receive(&msg);
-    }
+    // The threads start right away, the CoAP thread collects readings until the network is ready to send
+    startup_wait_network();
+
+    // Afterward, the main thread prints the error log while the other threads are idle. It runs with the same priority
+    // as the console before, so it drops to the lowest priority above the idle thread.
+    sched_change_priority(thread_get_active(), THREAD_PRIORITY_MIN - 1);
+    run_error_log();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+//
+// Created by vincent on 3/18/25.
+//
+
+#include <stdio.h>
+
+#include "sched.h"
+#include "thread.h"
+
+#include "mem_report.h"
+#include "coap_post.h"
+#include "outbox.h"
+#include "sample_buffer.h"
+#include "scheduler.h"
+#include "lowpower.h"
+#include "config_constants.h"
+#include "utils/error_handler.h"
+
+// Length of the compact report which is sent as message
+#define MEM_REPORT_LENGTH 256
+
+static mem_buffer_stats_t buffers[MEM_BUFFER_COUNT] = {
+    [MEM_BUFFER_COAP_PDU] = { "coap_pdu", COAP_BUF_SIZE, 0 },
+    [MEM_BUFFER_COAP_SLOTS] = { "coap_slots", COAP_REQUEST_SLOTS, 0 },
+    [MEM_BUFFER_SAMPLES] = { "samples", SAMPLE_BUFFER_SIZE, 0 },
+    [MEM_BUFFER_OUTBOX] = { "outbox", OUTBOX_SIZE, 0 },
+    [MEM_BUFFER_CHATS] = { "chats", MAX_CHAT_IDS, 0 },
+    [MEM_BUFFER_CHAT_NAMES] = { "chat_names", CHAT_NAME_POOL_SIZE, 0 },
+};
+
+static char report[MEM_REPORT_LENGTH];
+
+void mem_report_use(const mem_buffer_t buffer, const size_t used) {
+    // Updated by several threads without a lock, a lost update only delays the peak until the next use
+    if (buffer < MEM_BUFFER_COUNT && used > buffers[buffer].peak) {
+        buffers[buffer].peak = used;
+    }
+}
+
+// Get the highest stack usage of a thread, the unused part of the stack still holds the pattern written at creation.
+// Only threads created with THREAD_CREATE_STACKTEST (DEVELHELP) are painted, 0 otherwise.
+static size_t stack_used(const thread_t *thread) {
+#ifdef DEVELHELP
+    return thread_get_stacksize(thread) - thread_measure_stack_free(thread);
+#else
+    (void)thread;
+    return 0;
+#endif
+}
+
+// Get the name of a thread, only known with DEVELHELP
+static const char *thread_name(const thread_t *thread) {
+#ifdef DEVELHELP
+    return thread_get_name(thread);
+#else
+    (void)thread;
+    return "-";
+#endif
+}
+
+void mem_report_print(void) {
+    puts("Thread                 Stack used / size (bytes)");
+    for (kernel_pid_t pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST; pid++) {
+        const thread_t *thread = thread_get(pid);
+        if (thread) {
+            printf("%-20s %8u / %u\n", thread_name(thread), (unsigned)stack_used(thread),
+                (unsigned)thread_get_stacksize(thread));
+        }
+    }
+
+    puts("Buffer                 Peak / capacity");
+    for (int i = 0; i < MEM_BUFFER_COUNT; i++) {
+        printf("%-20s %8u / %u%s\n", buffers[i].name, (unsigned)buffers[i].peak, (unsigned)buffers[i].capacity,
+            buffers[i].peak > buffers[i].capacity ? " (too small)" : "");
+    }
+}
+
+size_t mem_report_format(char *buf, const size_t size) {
+    size_t len = 0;
+    for (kernel_pid_t pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST && len < size; pid++) {
+        const thread_t *thread = thread_get(pid);
+        if (thread) {
+            len += snprintf(buf + len, size - len, "%s%s:%u/%u", len > 0 ? ";" : "", thread_name(thread),
+                (unsigned)stack_used(thread), (unsigned)thread_get_stacksize(thread));
+        }
+    }
+    for (int i = 0; i < MEM_BUFFER_COUNT && len < size; i++) {
+        len += snprintf(buf + len, size - len, ";%s:%u/%u", buffers[i].name, (unsigned)buffers[i].peak,
+            (unsigned)buffers[i].capacity);
+    }
+    return len < size ? len : size - 1;
+}
+
+// Event: send the compact report to every chat
+static void on_send(event_t *event) {
+    (void)event;
+    mem_report_format(report, sizeof(report));
+    lowpower_radio_wake(LOWPOWER_RADIO_COAP);
+    int res = coap_post_send(report, "all");
+    if (res == COAP_SUCCESS) {
+        res = coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+    }
+    handle_error(__func__, res);
+    lowpower_radio_sleep(LOWPOWER_RADIO_COAP);
+}
+
+static event_t send_event = { .handler = on_send };
+
+void mem_report_schedule_send(void) {
+    scheduler_post(&send_event);
+}
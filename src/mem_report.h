@@ -0,0 +1,58 @@
+//
+// Created by vincent on 3/18/25.
+//
+
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stddef.h>
+
+/**
+ * Static buffers whose peak usage is tracked
+ */
+typedef enum {
+    MEM_BUFFER_COAP_PDU = 0,                    /**< Bytes of a request in the PDU buffer of a slot */
+    MEM_BUFFER_COAP_SLOTS,                      /**< Request slots in use at the same time */
+    MEM_BUFFER_SAMPLES,                         /**< Samples in the sample buffer */
+    MEM_BUFFER_OUTBOX,                          /**< Undelivered samples in the outbox (RAM) */
+    MEM_BUFFER_CHATS,                           /**< Chats in the chat directory */
+    MEM_BUFFER_CHAT_NAMES,                      /**< Bytes used in the name pool of the chat directory */
+    MEM_BUFFER_COUNT
+} mem_buffer_t;
+
+/**
+ * Peak usage of a static buffer
+ */
+typedef struct {
+    const char *name;                           /**< Name printed in the report */
+    size_t capacity;                            /**< Size of the buffer, in the unit of the usage */
+    size_t peak;                                /**< Highest usage since the boot */
+} mem_buffer_stats_t;
+
+/**
+ * Record the current usage of a buffer, only the peak is kept. A usage above the capacity means that the buffer was
+ * too small and the data was cut or rejected.
+ * @param buffer The buffer.
+ * @param used Current usage, in the unit of the buffer.
+ */
+void mem_report_use(mem_buffer_t buffer, size_t used);
+
+/**
+ * Print the stack high-water mark of every thread and the peak usage of the static buffers.
+ */
+void mem_report_print(void);
+
+/**
+ * Write a compact report (stack peaks and buffer peaks) into a string, e.g. to send it as message.
+ * @param buf Buffer receiving the report.
+ * @param size Size of the buffer.
+ * @return Length of the report.
+ */
+size_t mem_report_format(char *buf, size_t size);
+
+/**
+ * Send the compact report to every chat from the CoAP thread, triggered by the "m" configuration command.
+ */
+void mem_report_schedule_send(void);
+
+#endif //MEM_REPORT_H
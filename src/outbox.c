@@ -0,0 +1,170 @@
+//
+// Created by vincent on 3/10/25.
+//
+
+#include <stdio.h>
+
+#include "random.h"
+
+#include "outbox.h"
+#include "mem_report.h"
+#include "utils/error_handler.h"
+
+#if ENABLE_OUTBOX_FLASH == 1 && defined(MODULE_MTD)
+#include "board.h"
+#include "mtd.h"
+#endif
+
+static outbox_t outbox;
+
+#if ENABLE_OUTBOX_FLASH == 1 && defined(MODULE_MTD)
+// The flash overflow uses the last OUTBOX_MTD_SECTORS sectors of the first MTD device
+static mtd_dev_t *overflow_mtd(void) {
+    return MTD_0;
+}
+
+// Get the address of the first record of the flash overflow
+static uint32_t overflow_base(void) {
+    const mtd_dev_t *mtd = overflow_mtd();
+    return (mtd->sector_count - OUTBOX_MTD_SECTORS) * mtd->pages_per_sector * mtd->page_size;
+}
+
+static void overflow_init(void) {
+    mtd_dev_t *mtd = overflow_mtd();
+    if (mtd_init(mtd) != 0 || mtd->sector_count <= OUTBOX_MTD_SECTORS) {
+        handle_error(__func__, ERROR_OUTBOX_FLASH);
+        return;
+    }
+
+    // The timestamps of samples from before a reboot are meaningless, therefore the overflow always starts empty
+    if (mtd_erase_sector(mtd, mtd->sector_count - OUTBOX_MTD_SECTORS, OUTBOX_MTD_SECTORS) != 0) {
+        handle_error(__func__, ERROR_OUTBOX_FLASH);
+        return;
+    }
+    outbox.overflow_capacity = OUTBOX_MTD_SECTORS * mtd->pages_per_sector * mtd->page_size / sizeof(sample_t);
+}
+
+// Append a sample to the flash overflow, the records are only written once until the overflow is erased again
+static bool overflow_write(const sample_t *sample) {
+    if (outbox.overflow_write >= outbox.overflow_capacity) {
+        return false;
+    }
+    mtd_dev_t *mtd = overflow_mtd();
+    const uint32_t addr = overflow_base() + outbox.overflow_write * sizeof(sample_t);
+    if (mtd_write_page_raw(mtd, sample, addr / mtd->page_size, addr % mtd->page_size, sizeof(sample_t)) != 0) {
+        handle_error(__func__, ERROR_OUTBOX_FLASH);
+        return false;
+    }
+    outbox.overflow_write++;
+    return true;
+}
+
+// Read the oldest sample from the flash overflow, the overflow is erased once it is empty
+static bool overflow_read(sample_t *sample) {
+    if (outbox.overflow_read == outbox.overflow_write) {
+        return false;
+    }
+    mtd_dev_t *mtd = overflow_mtd();
+    const uint32_t addr = overflow_base() + outbox.overflow_read * sizeof(sample_t);
+    if (mtd_read(mtd, sample, addr, sizeof(sample_t)) != 0) {
+        handle_error(__func__, ERROR_OUTBOX_FLASH);
+        return false;
+    }
+    outbox.overflow_read++;
+
+    if (outbox.overflow_read == outbox.overflow_write) {
+        mtd_erase_sector(mtd, mtd->sector_count - OUTBOX_MTD_SECTORS, OUTBOX_MTD_SECTORS);
+        outbox.overflow_read = 0;
+        outbox.overflow_write = 0;
+    }
+    return true;
+}
+#else
+static void overflow_init(void) {
+    outbox.overflow_capacity = 0;
+}
+
+static bool overflow_write(const sample_t *sample) {
+    (void)sample;
+    return false;
+}
+
+static bool overflow_read(sample_t *sample) {
+    (void)sample;
+    return false;
+}
+#endif
+
+void outbox_init(void) {
+    outbox.head = 0;
+    outbox.count = 0;
+    outbox.attempts = 0;
+    outbox.dropped = 0;
+    outbox.overflow_read = 0;
+    outbox.overflow_write = 0;
+    overflow_init();
+}
+
+void outbox_store(const sample_t *sample) {
+    if (!sample) {
+        handle_error(__func__, ERROR_NULL_POINTER);
+        return;
+    }
+
+    // Make room by moving the oldest sample to flash, or drop it if there is no space left
+    if (outbox.count == OUTBOX_SIZE) {
+        if (!overflow_write(&outbox.samples[outbox.head])) {
+            outbox.dropped++;
+            handle_error(__func__, ERROR_OUTBOX_FULL);
+        }
+        outbox.head = (outbox.head + 1) % OUTBOX_SIZE;
+        outbox.count--;
+    }
+
+    outbox.samples[(outbox.head + outbox.count) % OUTBOX_SIZE] = *sample;
+    outbox.count++;
+    mem_report_use(MEM_BUFFER_OUTBOX, outbox.count);
+}
+
+uint8_t outbox_count(void) {
+    return outbox.count;
+}
+
+const sample_t *outbox_at(const uint8_t i) {
+    return &outbox.samples[(outbox.head + i) % OUTBOX_SIZE];
+}
+
+uint32_t outbox_overflow_count(void) {
+    return outbox.overflow_write - outbox.overflow_read;
+}
+
+uint16_t outbox_dropped(void) {
+    return outbox.dropped;
+}
+
+void outbox_delivered(void) {
+    outbox.head = 0;
+    outbox.count = 0;
+    outbox.attempts = 0;
+
+    // The older samples from flash are delivered with the next batches
+    while (outbox.count < OUTBOX_SIZE && overflow_read(&outbox.samples[outbox.count])) {
+        outbox.count++;
+    }
+}
+
+uint32_t outbox_failed(void) {
+    if (outbox.attempts < UINT8_MAX) {
+        outbox.attempts++;
+    }
+
+    // Exponential backoff: base, 2 * base, 4 * base, ... up to the maximum
+    uint32_t delay = OUTBOX_RETRY_MAX;
+    if (outbox.attempts <= 16 && ((uint32_t)OUTBOX_RETRY_BASE << (outbox.attempts - 1)) < OUTBOX_RETRY_MAX) {
+        delay = (uint32_t)OUTBOX_RETRY_BASE << (outbox.attempts - 1);
+    }
+    delay *= 1000;
+
+    // Jitter: pick a random delay between half and the full value
+    return delay / 2 + random_uint32_range(0, delay / 2 + 1);
+}
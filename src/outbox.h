@@ -0,0 +1,79 @@
+//
+// Created by vincent on 3/10/25.
+//
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_constants.h"
+#include "sample_buffer.h"
+
+/**
+ * Store the samples which could not be delivered to the websocket and the state of the retries
+ */
+typedef struct {
+    sample_t samples[OUTBOX_SIZE];              /**< Undelivered samples, oldest first */
+    uint8_t head;                               /**< Index of the oldest sample */
+    uint8_t count;                              /**< Number of samples in RAM */
+    uint8_t attempts;                           /**< Failed delivery attempts in a row */
+    uint16_t dropped;                           /**< Samples lost because the outbox was full */
+    uint32_t overflow_read;                     /**< Index of the oldest sample in the flash overflow */
+    uint32_t overflow_write;                    /**< Index of the next free record in the flash overflow */
+    uint32_t overflow_capacity;                 /**< Number of records in the flash overflow, 0 without MTD */
+} outbox_t;
+
+/**
+ * Initialize the outbox, on boards with MTD the flash overflow is erased.
+ */
+void outbox_init(void);
+
+/**
+ * Append an undelivered sample. If the outbox is full, the oldest sample is moved to the flash overflow. Without
+ * MTD or if the flash overflow is full too, the oldest sample is dropped.
+ * @param sample Pointer to the sample.
+ */
+void outbox_store(const sample_t *sample);
+
+/**
+ * Get the number of samples in RAM, these are sent with the next batch.
+ * @return Number of samples.
+ */
+uint8_t outbox_count(void);
+
+/**
+ * Get the sample at position i, counted from the oldest sample in RAM.
+ * @param i Position of the sample, has to be smaller than outbox_count().
+ * @return Pointer to the sample.
+ */
+const sample_t *outbox_at(uint8_t i);
+
+/**
+ * Get the number of samples waiting in the flash overflow.
+ * @return Number of samples.
+ */
+uint32_t outbox_overflow_count(void);
+
+/**
+ * Get the number of samples which were dropped because the outbox was full.
+ * @return Number of samples.
+ */
+uint16_t outbox_dropped(void);
+
+/**
+ * Remove the samples in RAM after they have been delivered and refill the outbox from the flash overflow.
+ * The backoff is reset.
+ */
+void outbox_delivered(void);
+
+/**
+ * Record a failed delivery and compute the delay until the next attempt. The delay doubles with every failed attempt
+ * up to OUTBOX_RETRY_MAX seconds. The delay is randomized between half and the full value (jitter), which spreads the
+ * retries of several nodes after the gateway comes back.
+ * @return Delay until the next attempt in milliseconds.
+ */
+uint32_t outbox_failed(void);
+
+#endif //OUTBOX_H
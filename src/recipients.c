@@ -0,0 +1,249 @@
+//
+// Created by vincent on 4/2/25.
+//
+
+#include <stdio.h>
+
+#include "irq.h"
+#include "ztimer.h"
+
+#include "recipients.h"
+#include "configuration.h"
+#include "coap_post.h"
+#include "lowpower.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "utils/error_handler.h"
+
+// Length of the readings sent to the chats with their own schedule, e.g. "CPU Temperature 24.50 °C; ..."
+#define RECIPIENTS_MESSAGE_LENGTH 160
+#define MINUTES_PER_DAY 1440
+
+// Timer of a chat with its own interval. It is keyed by the chat ID, as the positions of the chats move when chats are
+// added or removed.
+typedef struct {
+    timer_wheel_timer_t timer;
+    int64_t chat_id;                // Chat the timer belongs to
+    uint16_t interval;              // Interval the timer runs with in minutes, 0 = the timer is unused
+} chat_timer_t;
+
+// One timer per chat with a schedule of its own, all of them post the same event, so chats due in the same tick are
+// served together. Only chats with a schedule entry can have an interval, so MAX_SCHEDULED_CHATS timers are enough.
+static chat_timer_t timers[MAX_SCHEDULED_CHATS];
+
+// Minute of the day at the tick clock_tick of the wheel
+static int clock_minute = RECIPIENTS_CLOCK_UNKNOWN;
+static uint32_t clock_tick;
+
+static void on_due(event_t *event);
+static event_t due_event = { .handler = on_due };
+static void on_changed(event_t *event);
+static event_t changed_event = { .handler = on_changed };
+static void on_clock(event_t *event);
+static event_t clock_event = { .handler = on_clock };
+
+// Minute of the day set by the shell or the websocket, taken over by on_clock() in the CoAP thread
+static int clock_pending;
+
+static uint32_t schedule_interval(const chat_schedule_t *schedule) {
+    return (uint32_t)schedule->interval * 60000;
+}
+
+// Get the timer of a chat, NULL if the chat has none
+static chat_timer_t *find_timer(const int64_t chat_id) {
+    for (uint8_t i = 0; i < MAX_SCHEDULED_CHATS; i++) {
+        if (timers[i].interval > 0 && timers[i].chat_id == chat_id) {
+            return &timers[i];
+        }
+    }
+    return NULL;
+}
+
+// Match the timers to the chats: a chat which keeps its interval keeps its timer and its cadence, only the timers of
+// removed chats and changed intervals are disarmed and the chats without a timer get one
+static void sync_timers(void) {
+    timer_wheel_t *wheel = scheduler_wheel();
+    for (uint8_t i = 0; i < MAX_SCHEDULED_CHATS; i++) {
+        if (timers[i].interval == 0) {
+            continue;
+        }
+        const int pos = config_find_chat_id(timers[i].chat_id);
+        if (pos < 0 || config_get_chat_schedule(pos)->interval != timers[i].interval) {
+            timer_wheel_clear(wheel, &timers[i].timer);
+            timers[i].interval = 0;
+        }
+    }
+    for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+        const chat_schedule_t *schedule = config_get_chat_schedule(i);
+        const int64_t chat_id = config_get_chat_ids()[i];
+        if (schedule->interval == 0 || find_timer(chat_id)) {
+            continue;
+        }
+        // There are as many timers as schedule entries, so an unused one is left
+        chat_timer_t *timer = NULL;
+        for (uint8_t t = 0; !timer && t < MAX_SCHEDULED_CHATS; t++) {
+            if (timers[t].interval == 0) {
+                timer = &timers[t];
+            }
+        }
+        if (!timer) {
+            break;
+        }
+        timer->chat_id = chat_id;
+        timer->interval = schedule->interval;
+        timer_wheel_set(wheel, &timer->timer, schedule_interval(schedule));
+    }
+}
+
+// Read the enabled channels into one line, the websocket removes line breaks
+static uint8_t write_readings(char *buf, const size_t size) {
+    sensor_reading_t readings[SENSORS_MAX_CHANNELS];
+    const uint8_t count = sensors_sample(readings, ztimer_now(ZTIMER_MSEC));
+    size_t len = 0;
+    buf[0] = '\0';
+    for (uint8_t i = 0; i < count && len < size; i++) {
+        char name[DEVICE_NAME_MAX_LEN];
+        char unit[SENSORS_UNIT_LENGTH];
+        char value[16];
+        sensors_name(readings[i].channel, name, sizeof(name));
+        sensors_unit(readings[i].unit, unit, sizeof(unit));
+        sensors_format_hundredths(sensors_hundredths(readings[i].value, readings[i].scale), value, sizeof(value));
+        len += snprintf(buf + len, size - len, "%s%s %s %s %s", i > 0 ? "; " : "", name,
+            sensors_quantity(readings[i].channel), value, unit);
+    }
+    return count;
+}
+
+// Event: the timers of one or more chats expired, their timers are disarmed
+static void on_due(event_t *event) {
+    (void)event;
+    chat_set_t chats = { 0 };
+    const int minute = recipients_clock();
+
+    // Every chat due in this tick is added to the same request, a quiet chat skips this turn. A chat removed since is
+    // skipped, sync_timers() is already posted.
+    for (uint8_t i = 0; i < MAX_SCHEDULED_CHATS; i++) {
+        if (timers[i].interval == 0 || timers[i].timer.armed) {
+            continue;
+        }
+        const int pos = config_find_chat_id(timers[i].chat_id);
+        if (pos < 0) {
+            continue;
+        }
+        const chat_schedule_t *schedule = config_get_chat_schedule(pos);
+        timer_wheel_set(scheduler_wheel(), &timers[i].timer, schedule_interval(schedule));
+        if (minute == RECIPIENTS_CLOCK_UNKNOWN || !chat_schedule_quiet(schedule, minute)) {
+            chat_set_add(&chats, pos);
+        }
+    }
+    if (chat_set_count(&chats) == 0 || !scheduler_network_is_ready()) {
+        return;
+    }
+
+    char message[RECIPIENTS_MESSAGE_LENGTH];
+    if (write_readings(message, sizeof(message)) == 0) {
+        return;
+    }
+    lowpower_radio_wake(LOWPOWER_RADIO_COAP);
+    int res = coap_post_send_to(message, &chats);
+    if (res == COAP_SUCCESS) {
+        res = coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+    }
+    handle_error(__func__, res);
+    lowpower_radio_sleep(LOWPOWER_RADIO_COAP);
+}
+
+// Event: the chats or their schedules changed
+static void on_changed(event_t *event) {
+    (void)event;
+    sync_timers();
+}
+
+// Event: the clock was set, a minute set several times before is only applied once with its latest value
+static void on_clock(event_t *event) {
+    (void)event;
+    const uint32_t tick = timer_wheel_now(scheduler_wheel());
+    const unsigned state = irq_disable();
+    clock_minute = clock_pending;
+    clock_tick = tick;
+    irq_restore(state);
+}
+
+void recipients_init(void) {
+    for (uint8_t i = 0; i < MAX_SCHEDULED_CHATS; i++) {
+        timer_wheel_timer_init(&timers[i].timer, &due_event);
+    }
+    sync_timers();
+}
+
+void recipients_changed(void) {
+    scheduler_post(&changed_event);
+}
+
+bool recipients_batch(chat_set_t *chats) {
+    const int minute = recipients_clock();
+    bool subset = false;
+    for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+        const chat_schedule_t *schedule = config_get_chat_schedule(i);
+        if (schedule->interval > 0
+            || (minute != RECIPIENTS_CLOCK_UNKNOWN && chat_schedule_quiet(schedule, minute))) {
+            subset = true;
+            continue;
+        }
+        chat_set_add(chats, i);
+    }
+    return subset;
+}
+
+int recipients_set_clock(const int minute) {
+    if (minute < 0 || minute >= MINUTES_PER_DAY) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    // The tick of the minute is taken in the CoAP thread, which owns the wheel. Until then the previous clock stays.
+    const unsigned state = irq_disable();
+    clock_pending = minute;
+    irq_restore(state);
+    scheduler_post(&clock_event);
+    return CONFIG_SUCCESS;
+}
+
+int recipients_clock(void) {
+    const unsigned state = irq_disable();
+    const int minute = clock_minute;
+    const uint32_t tick = clock_tick;
+    irq_restore(state);
+    if (minute == RECIPIENTS_CLOCK_UNKNOWN) {
+        return RECIPIENTS_CLOCK_UNKNOWN;
+    }
+    const uint64_t elapsed = (uint64_t)(timer_wheel_now(scheduler_wheel()) - tick) * TIMER_WHEEL_TICK / 60000;
+    return (int)((minute + elapsed) % MINUTES_PER_DAY);
+}
+
+bool recipients_is_event(const event_t *event) {
+    return event == &due_event;
+}
+
+void recipients_print(void) {
+    const int minute = recipients_clock();
+    if (minute == RECIPIENTS_CLOCK_UNKNOWN) {
+        puts("Clock: not set, quiet windows are ignored.");
+    } else {
+        printf("Clock: %02d:%02d\n", minute / 60, minute % 60);
+    }
+
+    for (chat_index_t i = 0; i < config_get_chat_count(); i++) {
+        const chat_schedule_t *schedule = config_get_chat_schedule(i);
+        printf("%-16s %20lld  ", config_get_chat_name(i), (long long)config_get_chat_ids()[i]);
+        if (schedule->interval > 0) {
+            printf("every %u min", schedule->interval);
+        } else {
+            printf("with the batches");
+        }
+        if (schedule->quiet_start != CHAT_QUIET_NONE && schedule->quiet_start != schedule->quiet_end) {
+            printf(", quiet %02u:%02u-%02u:%02u", schedule->quiet_start / 60, schedule->quiet_start % 60,
+                schedule->quiet_end / 60, schedule->quiet_end % 60);
+        }
+        puts("");
+    }
+}
@@ -0,0 +1,66 @@
+//
+// Created by vincent on 4/2/25.
+//
+
+#ifndef RECIPIENTS_H
+#define RECIPIENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event.h"
+
+#include "chat_directory.h"
+
+/**
+ * Minute of the day which is returned while the clock is not set
+ */
+#define RECIPIENTS_CLOCK_UNKNOWN (-1)
+
+/**
+ * Arm a timer of the wheel of the scheduler for every chat with its own interval, there are MAX_SCHEDULED_CHATS
+ * timers. Has to be called by the scheduler once its wheel is initialized.
+ */
+void recipients_init(void);
+
+/**
+ * Match the timers to the chats after the chats or their schedules changed, in the CoAP thread. Only the chats which
+ * were added, removed or got a new interval start a new cadence.
+ */
+void recipients_changed(void);
+
+/**
+ * Get the recipients of the next batch of samples: the chats without an interval of their own, which are not in their
+ * quiet window.
+ * @param chats Empty set receiving the positions of the recipients.
+ * @return Whether the batch goes to a subset of the chats, false if every chat receives it.
+ */
+bool recipients_batch(chat_set_t *chats);
+
+/**
+ * Set the time of day of the quiet windows, the device has no clock of its own. Until the clock is set, the quiet
+ * windows are ignored. The clock is taken over in the CoAP thread, which owns the timer wheel.
+ * @param minute Current minute of the day (0 to 1439).
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT for minutes beyond the day.
+ */
+int recipients_set_clock(int minute);
+
+/**
+ * Get the time of day, counted by the timer wheel from the last time the clock was set.
+ * @return Current minute of the day, RECIPIENTS_CLOCK_UNKNOWN if the clock is not set.
+ */
+int recipients_clock(void);
+
+/**
+ * Check if an event is the one posted for the chats which are due.
+ * @param event The event.
+ * @return Whether the event sends the readings to the chats with their own schedule.
+ */
+bool recipients_is_event(const event_t *event);
+
+/**
+ * Print the schedule of every chat and the time of day.
+ */
+void recipients_print(void);
+
+#endif //RECIPIENTS_H
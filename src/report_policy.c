@@ -0,0 +1,42 @@
+//
+// Created by vincent on 3/5/25.
+//
+
+#include <stdlib.h>
+
+#include "report_policy.h"
+#include "configuration.h"
+
+static report_policy_t report_policy[SENSORS_MAX_CHANNELS];
+
+bool report_policy_check(const sensor_reading_t *reading) {
+    if (!reading || reading->channel >= SENSORS_MAX_CHANNELS) {
+        return false;
+    }
+
+    report_policy_t *policy = &report_policy[reading->channel];
+    const int32_t value = sensors_hundredths(reading->value, reading->scale);
+    const int deadband = config_get_report_deadband();
+    const int heartbeat = config_get_report_heartbeat();
+    policy->skipped_intervals++;
+
+    // Report on first reading, on changes larger than the deadband (0 = every reading) and as heartbeat
+    const bool report = !policy->has_reported
+        || deadband <= 0
+        || abs((int)(value - policy->last_reported)) > deadband
+        || (heartbeat > 0 && policy->skipped_intervals >= heartbeat);
+
+    if (report) {
+        policy->last_reported = value;
+        policy->skipped_intervals = 0;
+        policy->has_reported = true;
+    }
+    return report;
+}
+
+void report_policy_reset(void) {
+    for (uint8_t i = 0; i < SENSORS_MAX_CHANNELS; i++) {
+        report_policy[i].has_reported = false;
+        report_policy[i].skipped_intervals = 0;
+    }
+}
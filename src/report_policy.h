@@ -0,0 +1,36 @@
+//
+// Created by vincent on 3/5/25.
+//
+
+#ifndef REPORT_POLICY_H
+#define REPORT_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+/**
+ * Store the state of the change-driven reporting of a channel
+ */
+typedef struct {
+    int32_t last_reported;                      /**< Last reported reading in hundredths of a unit */
+    uint16_t skipped_intervals;                 /**< Number of intervals since the last report */
+    bool has_reported;                          /**< Whether a temperature was reported yet */
+} report_policy_t;
+
+/**
+ * Decide if a reading is reported. A reading is reported if it differs by more than the deadband from the last
+ * reported reading of its channel, or if no reading of the channel was reported for the configured number of heartbeat
+ * intervals. A deadband of 0 reports every reading.
+ * @param reading Pointer to the reading.
+ * @return Whether the reading should be reported or not.
+ */
+bool report_policy_check(const sensor_reading_t *reading);
+
+/**
+ * Reset the reporting state of every channel, the next readings are always reported.
+ */
+void report_policy_reset(void);
+
+#endif //REPORT_POLICY_H
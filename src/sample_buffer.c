@@ -0,0 +1,215 @@
+//
+// Created by vincent on 3/3/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nanocbor/nanocbor.h"
+
+#include "sample_buffer.h"
+#include "mem_report.h"
+#include "outbox.h"
+#include "configuration.h"
+#include "sensors.h"
+#include "utils/error_handler.h"
+
+static sample_buffer_t sample_buffer;
+
+// Get the sample at position i, counted from the oldest sample
+static const sample_t *sample_at(const uint8_t i) {
+    return &sample_buffer.samples[(sample_buffer.head + i) % SAMPLE_BUFFER_SIZE];
+}
+
+// Get the number of samples in the next batch, the undelivered samples of the outbox are sent first
+static uint16_t batch_count(void) {
+    return outbox_count() + sample_buffer.count;
+}
+
+// Get the sample at position i of the next batch
+static const sample_t *batch_at(const uint16_t i) {
+    const uint8_t deferred = outbox_count();
+    return i < deferred ? outbox_at(i) : sample_at(i - deferred);
+}
+
+void sample_buffer_push(const sensor_reading_t *reading) {
+    if (!reading) {
+        handle_error(__func__, ERROR_NULL_POINTER);
+        return;
+    }
+
+    // Move the oldest sample to the outbox if the buffer is full, e.g. while the gateway is unreachable
+    if (sample_buffer.count == SAMPLE_BUFFER_SIZE) {
+        outbox_store(sample_at(0));
+        sample_buffer.head = (sample_buffer.head + 1) % SAMPLE_BUFFER_SIZE;
+        sample_buffer.count--;
+    }
+
+    sample_buffer.samples[(sample_buffer.head + sample_buffer.count) % SAMPLE_BUFFER_SIZE] = *reading;
+    sample_buffer.count++;
+    mem_report_use(MEM_BUFFER_SAMPLES, sample_buffer.count);
+}
+
+uint8_t sample_buffer_count(void) {
+    return sample_buffer.count;
+}
+
+bool sample_buffer_flush_due(const uint32_t now) {
+    if (sample_buffer.count == 0) {
+        return false;
+    }
+    if (sample_buffer.count >= config_get_sample_batch_size()) {
+        return true;
+    }
+    const uint32_t max_age = (uint32_t)config_get_sample_max_age() * 60000;
+    return (now - sample_at(0)->timestamp) >= max_age;
+}
+
+// Get the number of samples of a channel in the next batch and its newest sample, whose scale and unit are used
+static uint16_t channel_count(const uint8_t channel, const sample_t **newest) {
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < batch_count(); i++) {
+        const sample_t *sample = batch_at(i);
+        if (sample->channel == channel) {
+            *newest = sample;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Get the number of channels with samples in the next batch
+static uint8_t group_count(void) {
+    const sample_t *newest;
+    uint8_t groups = 0;
+    for (uint8_t channel = 0; channel < sensors_count(); channel++) {
+        groups += channel_count(channel, &newest) > 0;
+    }
+    return groups;
+}
+
+void sample_buffer_write(const sample_writer_t write, void *ctx, const uint32_t now) {
+    char piece[DEVICE_NAME_MAX_LEN + 16];
+    char device_name[DEVICE_NAME_MAX_LEN];
+    char unit[SENSORS_UNIT_LENGTH];
+    if (batch_count() == 0) {
+        handle_error(__func__, ERROR_INVALID_ARGUMENT);
+        return;
+    }
+
+    bool first = true;
+    for (uint8_t channel = 0; channel < sensors_count(); channel++) {
+        const sample_t *newest;
+        if (channel_count(channel, &newest) == 0) {
+            continue;
+        }
+
+        // Header: device name, scale and unit are shared by all samples of one channel
+        sensors_name(channel, device_name, sizeof(device_name));
+        int len = snprintf(piece, sizeof(piece), "%s%s,%d,%u", first ? "" : "|", device_name, newest->scale,
+            newest->unit);
+        write(ctx, piece, len);
+        if (sensors_channel(channel)->type != SAUL_SENSE_TEMP) {
+            sensors_unit(newest->unit, unit, sizeof(unit));
+            len = snprintf(piece, sizeof(piece), ",%s,%s", sensors_quantity(channel), unit);
+            write(ctx, piece, len);
+        }
+        first = false;
+
+        // Samples from oldest to newest, each with its age in seconds. Summaries append min, max and count.
+        for (uint16_t i = 0; i < batch_count(); i++) {
+            const sample_t *sample = batch_at(i);
+            if (sample->channel != channel) {
+                continue;
+            }
+            const unsigned long age = (now - sample->timestamp) / 1000;
+            if (sample->count > 1) {
+                len = snprintf(piece, sizeof(piece), ";%lu:%d:%d:%d:%u", age, sample->value, sample->min,
+                    sample->max, sample->count);
+            } else {
+                len = snprintf(piece, sizeof(piece), ";%lu:%d", age, sample->value);
+            }
+            write(ctx, piece, len);
+        }
+    }
+}
+
+// Encode one CBOR item with the encoder and pass it to the writer
+static void write_cbor(const sample_writer_t write, void *ctx, nanocbor_encoder_t *enc, uint8_t *piece) {
+    write(ctx, piece, nanocbor_encoded_len(enc));
+    nanocbor_encoder_init(enc, piece, SAMPLE_DATA_LENGTH);
+}
+
+// Encode a text string, the string itself is passed to the writer without copying
+static void write_cbor_tstr(const sample_writer_t write, void *ctx, nanocbor_encoder_t *enc, uint8_t *piece,
+                            const char *str) {
+    nanocbor_fmt_tstr(enc, strlen(str));
+    write_cbor(write, ctx, enc, piece);
+    write(ctx, str, strlen(str));
+}
+
+void sample_buffer_write_cbor(const sample_writer_t write, void *ctx, const uint32_t now) {
+    uint8_t piece[SAMPLE_DATA_LENGTH];
+    char device_name[DEVICE_NAME_MAX_LEN];
+    char unit[SENSORS_UNIT_LENGTH];
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, piece, sizeof(piece));
+
+    // A single channel is encoded as one group like before, several channels as array of groups
+    const uint8_t groups = group_count();
+    if (groups > 1) {
+        nanocbor_fmt_array(&enc, groups);
+    }
+
+    for (uint8_t channel = 0; channel < sensors_count(); channel++) {
+        const sample_t *newest;
+        const uint16_t count = channel_count(channel, &newest);
+        if (count == 0) {
+            continue;
+        }
+        const bool temperature = sensors_channel(channel)->type == SAUL_SENSE_TEMP;
+
+        sensors_name(channel, device_name, sizeof(device_name));
+        nanocbor_fmt_array(&enc, temperature ? 4 : 6);
+        write_cbor_tstr(write, ctx, &enc, piece, device_name);
+        nanocbor_fmt_int(&enc, newest->scale);
+        nanocbor_fmt_uint(&enc, newest->unit);
+
+        nanocbor_fmt_array(&enc, count);
+        write_cbor(write, ctx, &enc, piece);
+        for (uint16_t i = 0; i < batch_count(); i++) {
+            const sample_t *sample = batch_at(i);
+            if (sample->channel != channel) {
+                continue;
+            }
+            const bool summary = sample->count > 1;
+            nanocbor_fmt_array(&enc, summary ? 5 : 2);
+            nanocbor_fmt_uint(&enc, (now - sample->timestamp) / 1000);
+            nanocbor_fmt_int(&enc, sample->value);
+            if (summary) {
+                nanocbor_fmt_int(&enc, sample->min);
+                nanocbor_fmt_int(&enc, sample->max);
+                nanocbor_fmt_uint(&enc, sample->count);
+            }
+            write_cbor(write, ctx, &enc, piece);
+        }
+
+        if (!temperature) {
+            sensors_unit(newest->unit, unit, sizeof(unit));
+            write_cbor_tstr(write, ctx, &enc, piece, sensors_quantity(channel));
+            write_cbor_tstr(write, ctx, &enc, piece, unit);
+        }
+    }
+}
+
+void sample_buffer_clear(void) {
+    sample_buffer.head = 0;
+    sample_buffer.count = 0;
+}
+
+void sample_buffer_defer(void) {
+    for (uint8_t i = 0; i < sample_buffer.count; i++) {
+        outbox_store(sample_at(i));
+    }
+    sample_buffer_clear();
+}
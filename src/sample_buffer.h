@@ -0,0 +1,88 @@
+//
+// Created by vincent on 3/3/25.
+//
+
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_constants.h"
+#include "sensors.h"
+
+/**
+ * Store a single reading of a sensor channel as it was read
+ */
+typedef sensor_reading_t sample_t;
+
+/**
+ * Fixed-capacity ring buffer of samples waiting to be sent
+ */
+typedef struct {
+    sample_t samples[SAMPLE_BUFFER_SIZE];       /**< Sample storage */
+    uint8_t head;                               /**< Index of the oldest sample */
+    uint8_t count;                              /**< Number of stored samples */
+} sample_buffer_t;
+
+/**
+ * Receive a piece of an encoded batch
+ */
+typedef void (*sample_writer_t)(void *ctx, const void *data, size_t len);
+
+/**
+ * Store a reading in the ring buffer, its timestamp is the time of the reading.
+ * If the buffer is full, the oldest sample is moved to the outbox.
+ * @param reading Pointer to the reading.
+ */
+void sample_buffer_push(const sensor_reading_t *reading);
+
+/**
+ * Get the number of samples currently stored.
+ * @return Number of samples.
+ */
+uint8_t sample_buffer_count(void);
+
+/**
+ * Check if the samples should be sent, either because the batch is full or the oldest sample is too old.
+ * @param now Current time in milliseconds.
+ * @return Whether the buffer should be flushed or not.
+ */
+bool sample_buffer_flush_due(uint32_t now);
+
+/**
+ * Encode all stored samples, preceded by the undelivered samples of the outbox, into the compact batch format
+ * "<device>,<scale>,<unit>;<age>:<value>;...". The age is given in seconds relative to now. The samples of every
+ * channel form a group, groups are separated by '|'. Channels which are no temperature append their quantity and unit
+ * to the header: "<device>,<scale>,<unit>,<quantity>,<unit symbol>". Summaries of oversampled readings are encoded as
+ * "<age>:<mean>:<min>:<max>:<count>". The batch is passed to the writer piece by piece,
+ * which allows the caller to stream it (e.g. block-wise) without holding the whole batch in memory.
+ * @param write Function receiving the encoded pieces in order.
+ * @param ctx Context passed to the writer.
+ * @param now Current time in milliseconds.
+ */
+void sample_buffer_write(sample_writer_t write, void *ctx, uint32_t now);
+
+/**
+ * Encode the undelivered samples of the outbox and all stored samples as CBOR array
+ * [device, scale, unit, [[age, value], ...]], followed by quantity and unit symbol for channels which are no
+ * temperature. Several channels are encoded as array of these groups, summaries as [age, mean, min, max, count]. The
+ * raw readings are kept as integers, the age is given in seconds relative to now. The items are passed to the writer one by one, like in sample_buffer_write().
+ * @param write Function receiving the encoded pieces in order.
+ * @param ctx Context passed to the writer.
+ * @param now Current time in milliseconds.
+ */
+void sample_buffer_write_cbor(sample_writer_t write, void *ctx, uint32_t now);
+
+/**
+ * Remove all samples from the buffer, used after they have been sent successfully.
+ */
+void sample_buffer_clear(void);
+
+/**
+ * Move all samples to the outbox after sending failed, the buffer is empty afterward.
+ */
+void sample_buffer_defer(void);
+
+#endif //SAMPLE_BUFFER_H
@@ -0,0 +1,346 @@
+//
+// Created by vincent on 3/8/25.
+//
+
+#include "log.h"
+#include "ztimer.h"
+
+#include "scheduler.h"
+#include "led_control.h"
+#include "configuration.h"
+#include "sensors.h"
+#include "coap_post.h"
+#include "sample_buffer.h"
+#include "aggregate.h"
+#include "alert.h"
+#include "recipients.h"
+#include "outbox.h"
+#include "report_policy.h"
+#include "startup.h"
+#include "lowpower.h"
+#include "stats.h"
+#include "utils/error_handler.h"
+
+static scheduler_t scheduler;
+
+static void on_retry(event_t *event);
+static event_t retry_event = { .handler = on_retry };
+static void on_ready(event_t *event);
+static event_t ready_event = { .handler = on_ready };
+
+// Get the notification interval in milliseconds
+static uint32_t scheduler_interval(void) {
+    return (uint32_t)config_get_notification_interval() * INTERVAL_UNIT;
+}
+
+// Send the alerts of the last readings right away, independent of the batches. Before the network is ready they stay
+// pending until the next reading.
+static void send_alerts(void) {
+    if (scheduler.network_ready) {
+        alert_send_pending();
+    }
+}
+
+// Read the enabled sensors and add the readings to the windows of their channels
+static void subsample(const uint32_t now) {
+    sensor_reading_t readings[SENSORS_MAX_CHANNELS];
+    const uint8_t count = sensors_sample(readings, now);
+    for (uint8_t i = 0; i < count; i++) {
+        alert_check(&readings[i]);
+        aggregate_add(&readings[i]);
+    }
+    send_alerts();
+}
+
+// Register once, afterward the requests only carry the session ID instead of the credentials
+static bool session_register(void) {
+    if (!coap_session_valid() && coap_post_register() == COAP_SUCCESS) {
+        coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+    }
+    if (coap_session_valid()) {
+        startup_mark(STARTUP_GATEWAY);
+        return true;
+    }
+    return false;
+}
+
+// Send the samples to the chats without a schedule of their own, which are not quiet. A batch without any recipient
+// counts as delivered.
+static int send_batch(const uint32_t start_time) {
+    chat_set_t chats = { 0 };
+    const bool subset = recipients_batch(&chats);
+    if (subset && chat_set_count(&chats) == 0) {
+        LOG_DEBUG("No chat receives the batch, every chat has its own schedule or is quiet.\n");
+        return COAP_SUCCESS;
+    }
+
+    // Without a subset every chat receives the batch, the session knows them
+    int res = coap_post_send_samples(start_time, subset ? &chats : NULL);
+    if (res == COAP_SUCCESS) {
+        res = coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+    }
+    return res;
+}
+
+// Send the collected samples together with the undelivered samples of the outbox
+static void flush_samples(const uint32_t start_time) {
+    lowpower_radio_wake(LOWPOWER_RADIO_COAP);
+    session_register();
+
+    // Observe the configuration, afterward updates from Telegram are pushed. If the websocket does not support
+    // observing, the updates are piggybacked on the response to the samples instead of fetching them separately.
+    // A sleeping radio would miss the notifications, therefore leaf nodes always use the piggybacked updates.
+    if (ENABLE_LOW_POWER != 1 && !coap_observe_active() && coap_observe_possible()) {
+        int update_res = coap_observe_config();
+        if (update_res == COAP_SUCCESS) {
+            update_res = coap_post_wait_response(COAP_RESPONSE_TIMEOUT);
+        }
+        handle_error(__func__, update_res);
+    }
+
+    // Send all collected samples in one CoAP message
+    if (app_config.enable_led_feedback) {
+        led_control_execute(0, "on");
+    }
+    int send_res = send_batch(start_time);
+    handle_error(__func__, send_res);
+
+    if (send_res == COAP_SUCCESS) {
+        // Drain the rest of the backlog (refilled from flash) right away while the gateway is reachable
+        timer_wheel_clear(&scheduler.wheel, &scheduler.retry_timer);
+        sample_buffer_clear();
+        outbox_delivered();
+        if (outbox_count() > 0) {
+            event_post(&scheduler.queue, &retry_event);  // The radio stays awake for the rest of the backlog
+        } else {
+            lowpower_radio_sleep(LOWPOWER_RADIO_COAP);
+        }
+    } else {
+        // Keep the samples in the outbox and retry with backoff, new readings are collected meanwhile
+        sample_buffer_defer();
+        lowpower_radio_sleep(LOWPOWER_RADIO_COAP);
+        const uint32_t delay = outbox_failed();
+        timer_wheel_set(&scheduler.wheel, &scheduler.retry_timer, delay);
+        LOG_DEBUG("Sending failed, retrying %u samples in %lu s.\n", outbox_count(), (unsigned long)(delay / 1000));
+    }
+    // Printed on every cycle, only in debug builds (the benchmark counts the notifications by this line)
+    uint32_t elapsed_time = ztimer_now(ZTIMER_MSEC) - start_time;  // Compute elapsed time
+    LOG_DEBUG("CoAP communication took %lu ms to finish.\n", (unsigned long)elapsed_time);
+
+    if (app_config.enable_led_feedback) {
+        led_control_execute(0, "off");
+    }
+}
+
+// Read the enabled sensors and send the collected samples if a batch is due
+static void notification_cycle(const uint32_t start_time) {
+    // Collect the readings which changed enough, all sensors are read in one wake-up and the radio is only used once a
+    // batch is complete
+    sensor_reading_t readings[SENSORS_MAX_CHANNELS];
+    const uint32_t read_start = stats_start();
+    uint8_t count = sensors_sample(readings, start_time);
+    stats_record(STATS_SENSOR_READ, read_start);
+    for (uint8_t i = 0; i < count; i++) {
+        alert_check(&readings[i]);
+    }
+    send_alerts();
+
+    // With oversampling, the reading of the cycle closes the window and only the summaries of the windows are reported
+    if (SAMPLE_SUBINTERVAL > 0) {
+        for (uint8_t i = 0; i < count; i++) {
+            aggregate_add(&readings[i]);
+        }
+        count = 0;
+        for (uint8_t channel = 0; channel < sensors_count(); channel++) {
+            readings[count].timestamp = start_time;
+            count += aggregate_take(channel, &readings[count]);
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (report_policy_check(&readings[i])) {
+            sample_buffer_push(&readings[i]);
+        }
+    }
+
+    // Until the network is ready, or while the outbox waits for its retry, the readings are only collected
+    if (!scheduler.network_ready || outbox_count() > 0 || !sample_buffer_flush_due(start_time)) {
+        return;
+    }
+    flush_samples(start_time);
+}
+
+// Event: retry sending the undelivered samples
+static void on_retry(event_t *event) {
+    (void)event;
+    if (outbox_count() > 0 || sample_buffer_count() > 0) {
+        stats_count(STATS_RETRIES);
+        flush_samples(ztimer_now(ZTIMER_MSEC));
+    }
+}
+
+// Event: the network is ready, send the readings collected since the boot right away
+static void on_ready(event_t *event) {
+    (void)event;
+#if STARTUP_WAIT_GATEWAY == 1
+    // Register first, which checks that the websocket is reachable. Until the startup timeout, failed attempts are
+    // repeated quickly instead of with the backoff of the outbox.
+    if (!session_register() && !startup_expired()) {
+        timer_wheel_set(&scheduler.wheel, &scheduler.ready_timer, STARTUP_GATEWAY_RETRY);
+        return;
+    }
+#endif
+    scheduler.network_ready = true;
+    if (sample_buffer_count() > 0 || outbox_count() > 0) {
+        flush_samples(ztimer_now(ZTIMER_MSEC));
+    } else {
+        lowpower_radio_sleep(LOWPOWER_RADIO_COAP);  // The radio was needed for the startup only
+    }
+}
+
+// Event: run the notification cycle and arm the timer for the next one
+static void on_cycle(event_t *event) {
+    (void)event;
+    scheduler.last_cycle = ztimer_now(ZTIMER_MSEC);
+    notification_cycle(scheduler.last_cycle);
+    if (scheduler.running) {
+        timer_wheel_set(&scheduler.wheel, &scheduler.cycle_timer, scheduler_interval());
+    }
+}
+
+// Event: read the sensors between two notification cycles and arm the timer for the next reading
+static void on_subsample(event_t *event) {
+    (void)event;
+    subsample(ztimer_now(ZTIMER_MSEC));
+    if (scheduler.running) {
+        timer_wheel_set(&scheduler.wheel, &scheduler.subsample_timer, (uint32_t)SAMPLE_SUBINTERVAL * 1000);
+    }
+}
+
+// Event: arm the timer for the remaining time of the (new) interval
+static void on_reschedule(event_t *event) {
+    (void)event;
+    if (!scheduler.running) {
+        return;
+    }
+    const uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - scheduler.last_cycle;
+    const uint32_t interval = scheduler_interval();
+    timer_wheel_clear(&scheduler.wheel, &scheduler.cycle_timer);
+    if (elapsed >= interval) {
+        on_cycle(NULL);
+    } else {
+        timer_wheel_set(&scheduler.wheel, &scheduler.cycle_timer, interval - elapsed);
+    }
+}
+
+// Event: start the periodic cycle
+static void on_start(event_t *event) {
+    (void)event;
+    if (!scheduler.running) {
+        scheduler.running = true;
+        on_reschedule(NULL);
+        if (SAMPLE_SUBINTERVAL > 0) {
+            timer_wheel_set(&scheduler.wheel, &scheduler.subsample_timer, (uint32_t)SAMPLE_SUBINTERVAL * 1000);
+        }
+    }
+}
+
+// Event: stop the periodic cycle
+static void on_stop(event_t *event) {
+    (void)event;
+    scheduler.running = false;
+    timer_wheel_clear(&scheduler.wheel, &scheduler.cycle_timer);
+    timer_wheel_clear(&scheduler.wheel, &scheduler.subsample_timer);
+}
+
+static event_t cycle_event = { .handler = on_cycle };
+static event_t subsample_event = { .handler = on_subsample };
+static event_t trigger_event = { .handler = on_cycle };
+static event_t reschedule_event = { .handler = on_reschedule };
+static event_t start_event = { .handler = on_start };
+static event_t stop_event = { .handler = on_stop };
+
+void scheduler_init(void) {
+    event_queue_init(&scheduler.queue);
+    timer_wheel_init(&scheduler.wheel, &scheduler.queue);
+    timer_wheel_timer_init(&scheduler.cycle_timer, &cycle_event);
+    timer_wheel_timer_init(&scheduler.retry_timer, &retry_event);
+    timer_wheel_timer_init(&scheduler.ready_timer, &ready_event);
+    timer_wheel_timer_init(&scheduler.subsample_timer, &subsample_event);
+    outbox_init();
+    recipients_init();
+    scheduler.running = true;
+    scheduler.network_ready = false;
+    event_post(&scheduler.queue, &cycle_event);
+    if (SAMPLE_SUBINTERVAL > 0) {
+        timer_wheel_set(&scheduler.wheel, &scheduler.subsample_timer, (uint32_t)SAMPLE_SUBINTERVAL * 1000);
+    }
+}
+
+// Get the cause of a wake-up from the event which woke the thread
+static lowpower_wakeup_t wakeup_cause(const event_t *event) {
+    if (event == &cycle_event) {
+        return LOWPOWER_WAKEUP_CYCLE;
+    }
+    if (event == &subsample_event) {
+        return LOWPOWER_WAKEUP_SUBSAMPLE;
+    }
+    if (event == &retry_event) {
+        return LOWPOWER_WAKEUP_RETRY;
+    }
+    if (event == &ready_event) {
+        return LOWPOWER_WAKEUP_STARTUP;
+    }
+    if (recipients_is_event(event)) {
+        return LOWPOWER_WAKEUP_SCHEDULE;
+    }
+    return LOWPOWER_WAKEUP_CONTROL;  // Triggered cycles, interval changes and the events of scheduler_post()
+}
+
+void scheduler_run(void) {
+    // Like event_loop(), but every event is counted as wake-up of the thread. The wheel only posts the events of its
+    // expired timers, these are counted instead.
+    while (1) {
+        event_t *event = event_wait(&scheduler.queue);
+        if (!timer_wheel_is_tick(&scheduler.wheel, event)) {
+            lowpower_wakeup(wakeup_cause(event));
+        }
+        event->handler(event);
+    }
+}
+
+void scheduler_reschedule(void) {
+    event_post(&scheduler.queue, &reschedule_event);
+}
+
+void scheduler_post(event_t *event) {
+    event_post(&scheduler.queue, event);
+}
+
+void scheduler_network_ready(void) {
+    event_post(&scheduler.queue, &ready_event);
+}
+
+bool scheduler_network_is_ready(void) {
+    return scheduler.network_ready;
+}
+
+timer_wheel_t *scheduler_wheel(void) {
+    return &scheduler.wheel;
+}
+
+void scheduler_trigger(void) {
+    event_post(&scheduler.queue, &trigger_event);
+}
+
+void scheduler_start(void) {
+    event_post(&scheduler.queue, &start_event);
+}
+
+void scheduler_stop(void) {
+    event_post(&scheduler.queue, &stop_event);
+}
+
+bool scheduler_is_running(void) {
+    return scheduler.running;
+}
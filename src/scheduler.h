@@ -0,0 +1,92 @@
+//
+// Created by vincent on 3/8/25.
+//
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event.h"
+
+#include "timer_wheel.h"
+
+/**
+ * Store the state of the notification scheduler
+ */
+typedef struct {
+    event_queue_t queue;                        /**< Event queue of the CoAP thread */
+    timer_wheel_t wheel;                        /**< Timer wheel of all timers, the only armed ztimer of the thread */
+    timer_wheel_timer_t cycle_timer;            /**< Periodic timer posting the notification cycle */
+    timer_wheel_timer_t retry_timer;            /**< Backoff timer posting the retry of undelivered samples */
+    timer_wheel_timer_t ready_timer;            /**< Timer posting the next registration attempt during the startup */
+    timer_wheel_timer_t subsample_timer;        /**< Timer posting the readings between two cycles (oversampling) */
+    uint32_t last_cycle;                        /**< Start of the last notification cycle in milliseconds */
+    bool running;                               /**< Whether the periodic notification cycle is armed */
+    bool network_ready;                         /**< Whether the startup is over, samples are only sent afterward */
+} scheduler_t;
+
+/**
+ * Initialize the event queue for the calling thread and schedule the first notification cycle immediately.
+ * Has to be called from the thread which runs scheduler_run().
+ */
+void scheduler_init(void);
+
+/**
+ * Process events forever, this function does not return.
+ */
+void scheduler_run(void);
+
+/**
+ * Reschedule the next notification cycle, e.g. after the interval changed.
+ * If the new interval has already passed since the last cycle, the cycle runs immediately.
+ */
+void scheduler_reschedule(void);
+
+/**
+ * Post an event to the event queue of the CoAP thread, e.g. to run work which must not block the caller.
+ * @param event Pointer to the event, posting an event which is already queued has no effect.
+ */
+void scheduler_post(event_t *event);
+
+/**
+ * Called by the startup once the network is ready (or the startup timed out). The readings collected since the boot
+ * are sent right away instead of after the first interval.
+ */
+void scheduler_network_ready(void);
+
+/**
+ * Check if the startup is over, messages are only sent afterward.
+ * @return Whether the network is ready.
+ */
+bool scheduler_network_is_ready(void);
+
+/**
+ * Get the timer wheel of the CoAP thread, its timers have to be set from this thread.
+ * @return Pointer to the wheel.
+ */
+timer_wheel_t *scheduler_wheel(void);
+
+/**
+ * Run a notification cycle immediately (on-demand read), the periodic cycle continues from there.
+ */
+void scheduler_trigger(void);
+
+/**
+ * Start the periodic notification cycle again after it was stopped.
+ */
+void scheduler_start(void);
+
+/**
+ * Stop the periodic notification cycle, the thread sleeps until the next event.
+ */
+void scheduler_stop(void);
+
+/**
+ * Check if the periodic notification cycle is running.
+ * @return Whether the scheduler is running or stopped.
+ */
+bool scheduler_is_running(void);
+
+#endif //SCHEDULER_H
@@ -0,0 +1,242 @@
+//
+// Created by vincent on 3/24/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "saul.h"
+#include "saul_reg.h"
+
+#include "sensors.h"
+#include "utils/error_handler.h"
+
+/**
+ * Key of a sensor class in SENSOR_CLASSES and the name of its quantity
+ */
+typedef struct {
+    uint8_t type;
+    const char *key;
+    const char *quantity;
+} sensor_class_t;
+
+static const sensor_class_t sensor_classes[] = {
+    { SAUL_SENSE_TEMP, "temp", "Temperature" },
+    { SAUL_SENSE_HUM, "hum", "Humidity" },
+    { SAUL_SENSE_PRESS, "press", "Pressure" },
+    { SAUL_SENSE_ACCEL, "accel", "Acceleration" },
+    { SAUL_SENSE_GYRO, "gyro", "Rotation" },
+    { SAUL_SENSE_MAG, "mag", "Magnetic field" },
+    { SAUL_SENSE_LIGHT, "light", "Light" },
+    { SAUL_SENSE_CO2, "co2", "CO2" },
+};
+
+#define SENSOR_CLASS_COUNT (sizeof(sensor_classes) / sizeof(sensor_classes[0]))
+
+static sensor_channel_t channels[SENSORS_MAX_CHANNELS];
+static uint8_t channel_count;
+
+// Get the class entry of a SAUL class, NULL for classes without a key
+static const sensor_class_t *sensor_class(const uint8_t type) {
+    for (size_t i = 0; i < SENSOR_CLASS_COUNT; i++) {
+        if (sensor_classes[i].type == type) {
+            return &sensor_classes[i];
+        }
+    }
+    return NULL;
+}
+
+// Check if a class is listed in SENSOR_CLASSES, e.g. "temp,hum" or "all"
+static bool class_selected(const uint8_t type) {
+    const char *list = SENSOR_CLASSES;
+    if (strcmp(list, "all") == 0) {
+        return true;
+    }
+    const sensor_class_t *class = sensor_class(type);
+    if (!class) {
+        return false;
+    }
+
+    const size_t key_len = strlen(class->key);
+    while (*list) {
+        const size_t len = strcspn(list, ",");
+        if (len == key_len && strncmp(list, class->key, len) == 0) {
+            return true;
+        }
+        list += len + (list[len] == ',');
+    }
+    return false;
+}
+
+// Add the channels of a sensor
+static void add_sensor(saul_reg_t *device, const char *name, const uint8_t type, const uint8_t dims) {
+    const bool enabled = class_selected(type);
+    for (uint8_t dim = 0; dim < dims; dim++) {
+        if (channel_count == SENSORS_MAX_CHANNELS) {
+            printf("Too many sensor channels, %s is not sampled completely.\n", name);
+            return;
+        }
+        channels[channel_count++] = (sensor_channel_t){
+            .device = device, .name = name, .type = type, .dim = dim, .dims = dims, .enabled = enabled
+        };
+    }
+}
+
+uint8_t sensors_init(void) {
+    channel_count = 0;
+
+#ifdef BOARD_NATIVE
+    // Mock sensor for the native platform
+    add_sensor(NULL, "Mock-Sensor", SAUL_SENSE_TEMP, 1);
+#else
+    // Walk the registry once, the readings of the notification cycle use the cached entries
+    for (saul_reg_t *device = saul_reg; device; device = device->next) {
+        if ((device->driver->type & SAUL_CAT_MASK) != SAUL_CAT_SENSE) {
+            continue;  // Actuators and buttons
+        }
+
+        // The number of dimensions is only known from a reading
+        phydat_t data;
+        const int dims = saul_reg_read(device, &data);
+        if (dims <= 0) {
+            handle_error(__func__, ERROR_SENSOR_READ_FAIL);
+            continue;
+        }
+        add_sensor(device, device->name, device->driver->type, (uint8_t)dims);
+    }
+#endif
+
+    if (channel_count == 0) {
+        handle_error(__func__, ERROR_NO_SENSOR);
+    }
+    return channel_count;
+}
+
+uint8_t sensors_count(void) {
+    return channel_count;
+}
+
+const sensor_channel_t *sensors_channel(const uint8_t channel) {
+    return channel < channel_count ? &channels[channel] : NULL;
+}
+
+saul_reg_t *sensors_find(const uint8_t type) {
+    for (uint8_t i = 0; i < channel_count; i++) {
+        if (channels[i].type == type) {
+            return channels[i].device;
+        }
+    }
+    return NULL;
+}
+
+int sensors_enable(const uint8_t channel, const bool enabled) {
+    if (channel >= channel_count) {
+        return ERROR_INVALID_ARGUMENT;
+    }
+    channels[channel].enabled = enabled;
+    return CONFIG_SUCCESS;
+}
+
+// Read a sensor, returns the number of dimensions or a negative value on failure
+static int read_sensor(const sensor_channel_t *channel, phydat_t *data) {
+#ifdef BOARD_NATIVE
+    (void)channel;
+    data->val[0] = 2500;  // Mock values for 25.00°C
+    data->scale = -2;
+    data->unit = UNIT_TEMP_C;
+    return 1;
+#else
+    return saul_reg_read(channel->device, data);
+#endif
+}
+
+uint8_t sensors_sample(sensor_reading_t *readings, const uint32_t now) {
+    uint8_t count = 0;
+    phydat_t data;
+    int dims = 0;
+    int read_at = -1;   // First channel of the sensor read last
+
+    // The channels of a sensor are next to each other, the sensor is read at its first enabled channel
+    for (uint8_t i = 0; i < channel_count; i++) {
+        const sensor_channel_t *channel = &channels[i];
+        if (!channel->enabled) {
+            continue;
+        }
+        if (read_at != i - channel->dim) {
+            read_at = i - channel->dim;
+            dims = read_sensor(channel, &data);
+            if (dims <= 0) {
+                handle_error(__func__, ERROR_SENSOR_READ_FAIL);
+            }
+        }
+        if (channel->dim >= dims) {
+            continue;
+        }
+
+        const int16_t value = data.val[channel->dim];
+        readings[count++] = (sensor_reading_t){
+            .value = value, .min = value, .max = value, .scale = data.scale, .unit = data.unit, .timestamp = now,
+            .count = 1, .channel = i
+        };
+    }
+    return count;
+}
+
+int sensors_name(const uint8_t channel, char *buf, const size_t size) {
+    if (channel >= channel_count) {
+        return snprintf(buf, size, "%s", "Unknown");
+    }
+
+    // Use 'CPU' as device name instead of NRF_TEMP in the case of nRF devices
+    const sensor_channel_t *ch = &channels[channel];
+    const char *name = strcmp(ch->name, "NRF_TEMP") == 0 ? "CPU" : ch->name;
+    if (ch->dims > 1) {
+        return snprintf(buf, size, "%s[%u]", name, ch->dim);
+    }
+    return snprintf(buf, size, "%s", name);
+}
+
+const char *sensors_quantity(const uint8_t channel) {
+    const sensor_class_t *class = channel < channel_count ? sensor_class(channels[channel].type) : NULL;
+    return class ? class->quantity : "Value";
+}
+
+int sensors_unit(const uint8_t unit, char *buf, const size_t size) {
+    int len = 0;
+#ifdef MODULE_PHYDAT
+    len = phydat_unit_write(buf, size - 1, unit);
+    if (len < 0) {
+        len = 0;
+    }
+#else
+    (void)unit;
+    (void)size;
+#endif
+    buf[len] = '\0';
+    return len;
+}
+
+int32_t sensors_hundredths(const int16_t raw, int8_t scale) {
+    int32_t value = raw;
+    for (; scale < -2; scale++) {
+        value /= 10;
+    }
+    for (; scale > -2; scale--) {
+        value *= 10;
+    }
+    return value;
+}
+
+int sensors_format_hundredths(const int32_t value, char *buf, const size_t size) {
+    const long magnitude = value < 0 ? -(long)value : (long)value;
+    return snprintf(buf, size, "%s%ld.%02ld", value < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+}
+
+void sensors_print(void) {
+    char name[DEVICE_NAME_MAX_LEN];
+    puts("Channel  Sampled  Quantity        Device");
+    for (uint8_t i = 0; i < channel_count; i++) {
+        sensors_name(i, name, sizeof(name));
+        printf("%7u  %-7s  %-14s  %s\n", i, channels[i].enabled ? "yes" : "no", sensors_quantity(i), name);
+    }
+}
@@ -0,0 +1,138 @@
+//
+// Created by vincent on 3/24/25.
+//
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "saul_reg.h"
+
+#include "config_constants.h"
+
+#define DEVICE_NAME_MAX_LEN 32
+#define SENSORS_UNIT_LENGTH 8
+
+/**
+ * Single reading of a channel in its raw (phydat_t like) fixed-point representation. A summary of several readings
+ * (see aggregate.h) carries their mean as value, a single reading has min = max = value and a count of 1.
+ */
+typedef struct {
+    int16_t value;                              /**< Raw reading, or the mean of a summary */
+    int16_t min;                                /**< Smallest reading of a summary */
+    int16_t max;                                /**< Largest reading of a summary */
+    int8_t scale;                               /**< Scale of measurement (10^scale) */
+    uint8_t unit;                               /**< Unit of the measurement */
+    uint32_t timestamp;                         /**< Time of the reading in milliseconds */
+    uint16_t count;                             /**< Number of summarized readings */
+    uint8_t channel;                            /**< Channel the reading belongs to */
+} sensor_reading_t;
+
+/**
+ * Sampled value of a SAUL sensor. Sensors with several dimensions (e.g. the three axes of an accelerometer) provide
+ * one channel per dimension.
+ */
+typedef struct {
+    saul_reg_t *device;                         /**< Cached SAUL registry entry, NULL for the mock sensor (native) */
+    const char *name;                           /**< Device name, without the dimension */
+    uint8_t type;                               /**< SAUL class of the sensor, e.g. SAUL_SENSE_TEMP */
+    uint8_t dim;                                /**< Dimension of the phydat_t of this channel */
+    uint8_t dims;                               /**< Number of dimensions of the sensor */
+    bool enabled;                               /**< Channel is sampled in the notification cycle */
+} sensor_channel_t;
+
+/**
+ * Enumerate the SAUL sensors once and cache their registry entries. The channels of the sensor classes listed in
+ * SENSOR_CLASSES (e.g. "temp,hum", "all") are enabled.
+ * @return Number of channels.
+ */
+uint8_t sensors_init(void);
+
+/**
+ * Get the number of channels.
+ * @return Number of channels.
+ */
+uint8_t sensors_count(void);
+
+/**
+ * Get a channel.
+ * @param channel Index of the channel.
+ * @return Pointer to the channel, NULL if there is no such channel.
+ */
+const sensor_channel_t *sensors_channel(uint8_t channel);
+
+/**
+ * Get the first cached SAUL registry entry of a class, instead of searching the registry.
+ * @param type SAUL class, e.g. SAUL_SENSE_TEMP.
+ * @return The registry entry, NULL if there is no such sensor.
+ */
+saul_reg_t *sensors_find(uint8_t type);
+
+/**
+ * Enable or disable sampling a channel.
+ * @param channel Index of the channel.
+ * @param enabled Whether the channel is sampled.
+ * @return CONFIG_SUCCESS or ERROR_INVALID_ARGUMENT if there is no such channel.
+ */
+int sensors_enable(uint8_t channel, bool enabled);
+
+/**
+ * Read every enabled channel, each sensor is read once even if several of its channels are enabled.
+ * @param readings Array receiving the readings, with space for SENSORS_MAX_CHANNELS readings.
+ * @param now Current time in milliseconds, stored as timestamp of the readings.
+ * @return Number of readings, failed sensors are skipped.
+ */
+uint8_t sensors_sample(sensor_reading_t *readings, uint32_t now);
+
+/**
+ * Write the name of a channel into a string: the device name (CPU instead of NRF_TEMP), followed by the dimension for
+ * sensors with several dimensions (e.g. "LSM303DLHC[1]").
+ * @param channel Index of the channel.
+ * @param buf Buffer receiving the name.
+ * @param size Size of the buffer.
+ * @return Length of the name.
+ */
+int sensors_name(uint8_t channel, char *buf, size_t size);
+
+/**
+ * Get the measured quantity of a channel, e.g. "Temperature" or "Humidity".
+ * @param channel Index of the channel.
+ * @return Name of the quantity.
+ */
+const char *sensors_quantity(uint8_t channel);
+
+/**
+ * Write the symbol of a unit into a string, e.g. "%" or "Pa". Empty without the phydat module (native).
+ * @param unit The unit (phydat_t).
+ * @param buf Buffer receiving the symbol.
+ * @param size Size of the buffer.
+ * @return Length of the symbol.
+ */
+int sensors_unit(uint8_t unit, char *buf, size_t size);
+
+/**
+ * Convert a raw reading to hundredths of a unit, e.g. 2500 (scale -2) -> 2500, 250 (scale -1) -> 2500.
+ * @param raw The raw reading.
+ * @param scale Scale of the reading (10^scale).
+ * @return The reading in hundredths of a unit.
+ */
+int32_t sensors_hundredths(int16_t raw, int8_t scale);
+
+/**
+ * Write hundredths of a unit as decimal number into a string, e.g. -205 -> "-2.05".
+ * @param value The value in hundredths.
+ * @param buf Buffer receiving the number.
+ * @param size Size of the buffer.
+ * @return Length of the number.
+ */
+int sensors_format_hundredths(int32_t value, char *buf, size_t size);
+
+/**
+ * Print the channels and whether they are sampled.
+ */
+void sensors_print(void);
+
+#endif //SENSORS_H
@@ -0,0 +1,114 @@
+//
+// Created by vincent on 3/16/25.
+//
+
+#include <stdio.h>
+
+#include "ztimer.h"
+#include "net/netif.h"
+#include "net/gnrc/netif.h"
+#include "net/gnrc/ipv6/nib/ft.h"
+
+#include "startup.h"
+#include "scheduler.h"
+#include "config_constants.h"
+#include "utils/error_handler.h"
+
+static startup_t startup;
+
+static const char *step_names[STARTUP_STEP_COUNT] = {
+    "netif up", "global address", "default route", "gateway"
+};
+
+// Get the time left until STARTUP_TIMEOUT in milliseconds
+static uint32_t startup_remaining(void) {
+    const uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - startup.started;
+    return elapsed >= (uint32_t)STARTUP_TIMEOUT * 1000 ? 0 : (uint32_t)STARTUP_TIMEOUT * 1000 - elapsed;
+}
+
+bool startup_expired(void) {
+    return startup_remaining() == 0;
+}
+
+void startup_mark(const startup_step_t step) {
+    if (!(startup.ready & (1 << step))) {
+        startup.ready |= 1 << step;
+        startup.ready_at[step] = ztimer_now(ZTIMER_MSEC) - startup.started;
+        printf("Startup: %s after %lu ms.\n", step_names[step], (unsigned long)startup.ready_at[step]);
+    }
+}
+
+// Check if there is an interface with its link up, interfaces without a link state (IEEE 802.15.4) are always up
+static gnrc_netif_t *netif_up(void) {
+    gnrc_netif_t *netif = gnrc_netif_iter(NULL);
+    netopt_enable_t link = NETOPT_ENABLE;
+    if (netif && netif_get_opt(&netif->netif, NETOPT_LINK, 0, &link, sizeof(link)) > 0 && link != NETOPT_ENABLE) {
+        return NULL;
+    }
+    return netif;
+}
+
+// Check if the forwarding table has a default route, RPL adds it as soon as a parent is selected
+static bool default_route(void) {
+    void *state = NULL;
+    gnrc_ipv6_nib_ft_t fte;
+    while (gnrc_ipv6_nib_ft_iter(NULL, 0, &state, &fte)) {
+        if (fte.dst_len == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void startup_wait_network(void) {
+    startup.started = ztimer_now(ZTIMER_MSEC);
+
+    // The address is published on the netif bus, the loop waits for it and wakes up as soon as it is assigned. The
+    // interface and the route are not published, they are checked on every wake-up, at the latest after
+    // STARTUP_POLL_INTERVAL ms. The address and the route (RPL parent) are independent of each other, so a route found
+    // before the address does not wait for it.
+    const uint8_t network = (1 << STARTUP_NETIF_UP) | (1 << STARTUP_GLOBAL_ADDRESS) | (1 << STARTUP_DEFAULT_ROUTE);
+    while (1) {
+        gnrc_netif_t *netif = netif_up();
+        if (netif) {
+            startup_mark(STARTUP_NETIF_UP);
+        }
+        if (default_route()) {
+            startup_mark(STARTUP_DEFAULT_ROUTE);
+        }
+        const uint32_t remaining = startup_remaining();
+        if ((startup.ready & network) == network || remaining == 0) {
+            break;
+        }
+
+        const uint32_t wait = remaining < STARTUP_POLL_INTERVAL ? remaining : STARTUP_POLL_INTERVAL;
+        if (netif && !(startup.ready & (1 << STARTUP_GLOBAL_ADDRESS))) {
+            // Returns right away if the interface has a global address already, otherwise on the address event
+            if (gnrc_netif_ipv6_wait_for_global_address(netif, wait)) {
+                startup_mark(STARTUP_GLOBAL_ADDRESS);
+            }
+        } else {
+            ztimer_sleep(ZTIMER_MSEC, wait);
+        }
+    }
+
+    // Send anyway after the timeout, e.g. the websocket may be reachable via a link-local address
+    if (!(startup.ready & (1 << STARTUP_DEFAULT_ROUTE))) {
+        handle_error(__func__, ERROR_STARTUP_TIMEOUT);
+    }
+    startup.finished = true;
+    scheduler_network_ready();
+}
+
+void startup_print(void) {
+    if (!startup.finished) {
+        puts("Startup: waiting for the network.");
+    }
+    for (int i = 0; i < STARTUP_STEP_COUNT; i++) {
+        if (startup.ready & (1 << i)) {
+            printf("Startup: %s after %lu ms.\n", step_names[i], (unsigned long)startup.ready_at[i]);
+        } else {
+            printf("Startup: %s not ready.\n", step_names[i]);
+        }
+    }
+}
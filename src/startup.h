@@ -0,0 +1,55 @@
+//
+// Created by vincent on 3/16/25.
+//
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Steps of the network startup, in the order they become ready
+ */
+typedef enum {
+    STARTUP_NETIF_UP = 0,                       /**< A network interface exists and its link is up */
+    STARTUP_GLOBAL_ADDRESS,                     /**< The interface has a valid global IPv6 address */
+    STARTUP_DEFAULT_ROUTE,                      /**< A default route is known, e.g. via the RPL parent */
+    STARTUP_GATEWAY,                            /**< The websocket accepted the registration (optional) */
+    STARTUP_STEP_COUNT
+} startup_step_t;
+
+/**
+ * Store the progress of the network startup
+ */
+typedef struct {
+    uint32_t started;                           /**< Start of the startup in milliseconds */
+    uint32_t ready_at[STARTUP_STEP_COUNT];      /**< Milliseconds after the start when each step was ready */
+    uint8_t ready;                              /**< Bitmask of the steps which are ready */
+    bool finished;                              /**< Whether the network startup is over, ready or timed out */
+} startup_t;
+
+/**
+ * Wait until the network is ready to send, or until STARTUP_TIMEOUT has passed, and hand over to the scheduler.
+ * Blocks the calling thread (the main thread), the CoAP and console threads run meanwhile.
+ */
+void startup_wait_network(void);
+
+/**
+ * Mark a step as ready, steps which are already ready keep their first time.
+ * @param step The step which is ready.
+ */
+void startup_mark(startup_step_t step);
+
+/**
+ * Check if STARTUP_TIMEOUT has passed since the start, afterward the startup does not wait any longer.
+ * @return Whether the startup timed out.
+ */
+bool startup_expired(void);
+
+/**
+ * Print the time each startup step took until it was ready.
+ */
+void startup_print(void);
+
+#endif //STARTUP_H
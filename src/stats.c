@@ -0,0 +1,119 @@
+//
+// Created by vincent on 3/20/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "irq.h"
+#include "ztimer.h"
+
+#include "stats.h"
+#include "config_constants.h"
+#include "utils/error_handler.h"
+
+static stats_histogram_t histograms[STATS_PHASE_COUNT];
+static uint32_t counters[STATS_COUNTER_COUNT];
+
+static const char *phase_names[STATS_PHASE_COUNT] = {
+    "sensor_read", "format", "packet_build", "send", "rtt"
+};
+
+static const char *counter_names[STATS_COUNTER_COUNT] = {
+    "timeouts", "retries", "requests", "tx_bytes"
+};
+
+// Get the bucket of a duration: the position of its highest bit above the shift
+static uint8_t stats_bucket(uint32_t duration) {
+    uint8_t bucket = 0;
+    duration >>= STATS_BUCKET_SHIFT;
+    while (duration > 0 && bucket < STATS_BUCKETS - 1) {
+        duration >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Current time in µs. With ztimer_ondemand (low_power = 1) only ZTIMER_MSEC is held by the timer wheel and
+// ZTIMER_USEC stops, so the time is taken in ms there. The product wraps, the difference is still right up to 71 minutes.
+static uint32_t stats_now(void) {
+    if (ENABLE_LOW_POWER == 1) {
+        return ztimer_now(ZTIMER_MSEC) * 1000;
+    }
+    return ztimer_now(ZTIMER_USEC);
+}
+
+uint32_t stats_start(void) {
+    return stats_now();
+}
+
+void stats_record(const stats_phase_t phase, const uint32_t start) {
+    const uint32_t duration = stats_now() - start;
+    stats_histogram_t *histogram = &histograms[phase];
+
+    // Recorded by the CoAP, console and gcoap threads, a few increments are cheaper than a mutex
+    const unsigned state = irq_disable();
+    histogram->buckets[stats_bucket(duration)]++;
+    histogram->count++;
+    if (duration > histogram->max) {
+        histogram->max = duration;
+    }
+    irq_restore(state);
+}
+
+void stats_count(const stats_counter_t counter) {
+    stats_add(counter, 1);
+}
+
+void stats_add(const stats_counter_t counter, const uint32_t value) {
+    const unsigned state = irq_disable();
+    counters[counter] += value;
+    irq_restore(state);
+}
+
+uint32_t stats_percentile(const stats_phase_t phase, const uint8_t percent) {
+    const stats_histogram_t *histogram = &histograms[phase];
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    // Rank of the percentile (rounded up), the bucket reaching it holds the percentile
+    const uint32_t rank = (uint32_t)(((uint64_t)histogram->count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < STATS_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            const uint32_t bound = 1UL << (STATS_BUCKET_SHIFT + i);
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;  // The last bucket has no upper bound
+}
+
+void stats_print(void) {
+    puts("Phase              count     p50 us     p99 us     max us");
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        printf("%-14s %9lu %10lu %10lu %10lu\n", phase_names[i], (unsigned long)histograms[i].count,
+            (unsigned long)stats_percentile(i, 50), (unsigned long)stats_percentile(i, 99),
+            (unsigned long)histograms[i].max);
+    }
+
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        printf("%-14s %9lu\n", counter_names[i], (unsigned long)counters[i]);
+    }
+
+    puts("Code  count  message");
+    for (int code = 0; code < ERROR_CODE_COUNT; code++) {
+        if (get_error_count(code) > 0) {
+            printf("%4d %6u  %s\n", code, get_error_count(code), get_error_message(code));
+        }
+    }
+}
+
+void stats_reset(void) {
+    const unsigned state = irq_disable();
+    memset(histograms, 0, sizeof(histograms));
+    memset(counters, 0, sizeof(counters));
+    irq_restore(state);
+    reset_error_counts();
+}
@@ -0,0 +1,97 @@
+//
+// Created by vincent on 3/20/25.
+//
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/**
+ * Number of buckets of a latency histogram
+ */
+#define STATS_BUCKETS 16
+
+/**
+ * Bucket 0 holds durations below 2^STATS_BUCKET_SHIFT µs (64 µs), every following bucket doubles the upper bound.
+ * The last bucket holds everything from 2^(STATS_BUCKET_SHIFT + STATS_BUCKETS - 2) µs (about 1 s) on.
+ */
+#define STATS_BUCKET_SHIFT 6
+
+/**
+ * Measured phases of a notification
+ */
+typedef enum {
+    STATS_SENSOR_READ = 0,                      /**< Reading the enabled sensors (sensors_sample) */
+    STATS_FORMAT,                               /**< Producing the payload of a request, every block */
+    STATS_PACKET_BUILD,                         /**< Writing the header and the options of a request */
+    STATS_SEND,                                 /**< Handing a request to gcoap */
+    STATS_RTT,                                  /**< From sending a request until its response arrived */
+    STATS_PHASE_COUNT
+} stats_phase_t;
+
+/**
+ * Counted events which are not errors
+ */
+typedef enum {
+    STATS_TIMEOUTS = 0,                         /**< Responses not received within COAP_RESPONSE_TIMEOUT */
+    STATS_RETRIES,                              /**< Retries of undelivered samples */
+    STATS_REQUESTS,                             /**< Requests handed to gcoap, every block counts */
+    STATS_TX_BYTES,                             /**< Bytes of the requests handed to gcoap */
+    STATS_COUNTER_COUNT
+} stats_counter_t;
+
+/**
+ * Histogram of the durations of a phase, with fixed power-of-two buckets
+ */
+typedef struct {
+    uint32_t buckets[STATS_BUCKETS];            /**< Number of durations in each bucket */
+    uint32_t count;                             /**< Number of durations */
+    uint32_t max;                               /**< Longest duration in µs */
+} stats_histogram_t;
+
+/**
+ * Get the start time of a measurement.
+ * @return Current time in µs, with a resolution of 1 ms in low-power builds.
+ */
+uint32_t stats_start(void);
+
+/**
+ * Record the duration of a phase, from the start time until now.
+ * @param phase The measured phase.
+ * @param start Start time returned by stats_start().
+ */
+void stats_record(stats_phase_t phase, uint32_t start);
+
+/**
+ * Count an event.
+ * @param counter The counted event.
+ */
+void stats_count(stats_counter_t counter);
+
+/**
+ * Add a value to a counter, e.g. a number of bytes.
+ * @param counter The counter.
+ * @param value Value to add.
+ */
+void stats_add(stats_counter_t counter, uint32_t value);
+
+/**
+ * Get a percentile of a phase, as the upper bound of the bucket containing it.
+ * @param phase The phase.
+ * @param percent Percentile, e.g. 50 or 99.
+ * @return Upper bound of the percentile in µs, 0 if nothing was recorded.
+ */
+uint32_t stats_percentile(stats_phase_t phase, uint8_t percent);
+
+/**
+ * Print the count, p50, p99 and maximum of every phase, the counters and how often each error code was handled.
+ */
+void stats_print(void);
+
+/**
+ * Reset the histograms, the counters and the error counts.
+ */
+void stats_reset(void);
+
+#endif //STATS_H
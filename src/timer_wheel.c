@@ -0,0 +1,185 @@
+//
+// Created by vincent on 4/2/25.
+//
+
+#include <string.h>
+
+#include "container.h"
+#include "irq.h"
+#include "ztimer.h"
+
+#include "timer_wheel.h"
+
+// Mark the next due tick to be searched again if the earliest timer leaves the wheel
+static void leave(timer_wheel_t *wheel, const timer_wheel_timer_t *timer) {
+    if (timer->due == wheel->next_due) {
+        wheel->next_stale = true;
+    }
+}
+
+// Remove a timer from the list of its slot
+static void unlink_timer(timer_wheel_t *wheel, timer_wheel_timer_t *timer) {
+    leave(wheel, timer);
+    timer_wheel_timer_t **link = &wheel->slots[timer->due % TIMER_WHEEL_SLOTS];
+    while (*link && *link != timer) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = timer->next;
+    }
+    timer->next = NULL;
+    timer->armed = false;
+}
+
+// Post the events of the expired timers of a slot, timers of a later round stay in the slot
+static void expire_slot(timer_wheel_t *wheel, const uint32_t slot) {
+    timer_wheel_timer_t **link = &wheel->slots[slot];
+    while (*link) {
+        timer_wheel_timer_t *timer = *link;
+        if ((int32_t)(timer->due - wheel->tick) <= 0) {
+            *link = timer->next;
+            timer->next = NULL;
+            timer->armed = false;
+            leave(wheel, timer);
+            event_post(wheel->queue, timer->event);
+        } else {
+            link = &timer->next;
+        }
+    }
+}
+
+// Move the wheel to the current time, every slot passed on the way expires its timers
+static void advance(timer_wheel_t *wheel) {
+    const uint32_t ticks = (ztimer_now(ZTIMER_MSEC) - wheel->tick_start) / TIMER_WHEEL_TICK;
+    if (ticks == 0) {
+        return;
+    }
+    // timer_wheel_now() may read the tick from other threads, it has to match its start
+    const unsigned state = irq_disable();
+    const uint32_t first = wheel->tick;
+    wheel->tick += ticks;
+    wheel->tick_start += ticks * TIMER_WHEEL_TICK;
+    irq_restore(state);
+
+    // After a full rotation every slot was passed, each one is visited once
+    if (ticks >= TIMER_WHEEL_SLOTS) {
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            expire_slot(wheel, slot);
+        }
+        return;
+    }
+    for (uint32_t i = 1; i <= ticks; i++) {
+        expire_slot(wheel, (first + i) % TIMER_WHEEL_SLOTS);
+    }
+}
+
+// Arm the ztimer for the next due tick, or disarm it if the wheel is empty. All timers are only searched if the earliest
+// one left the wheel.
+static void arm(timer_wheel_t *wheel) {
+    if (wheel->next_stale) {
+        uint32_t next = UINT32_MAX;
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            for (const timer_wheel_timer_t *timer = wheel->slots[slot]; timer; timer = timer->next) {
+                const uint32_t remaining = timer->due - wheel->tick;
+                if (remaining < next) {
+                    next = remaining;
+                }
+            }
+        }
+        wheel->next_armed = next != UINT32_MAX;
+        wheel->next_due = wheel->tick + next;
+        wheel->next_stale = false;
+    }
+
+    if (!wheel->next_armed) {
+        event_timeout_clear(&wheel->timeout);
+        return;
+    }
+    const uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - wheel->tick_start;
+    const uint32_t delay = (wheel->next_due - wheel->tick) * TIMER_WHEEL_TICK;
+    event_timeout_set(&wheel->timeout, delay > elapsed ? delay - elapsed : 0);
+}
+
+// Event: a due tick was reached
+static void on_tick(event_t *event) {
+    timer_wheel_t *wheel = container_of(event, timer_wheel_t, tick_event);
+    advance(wheel);
+    arm(wheel);
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, event_queue_t *queue) {
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    wheel->queue = queue;
+    wheel->tick_event.handler = on_tick;
+    wheel->tick = 0;
+    wheel->next_due = 0;
+    wheel->next_armed = false;
+    wheel->next_stale = false;
+    // With ztimer_ondemand, the clock stops while no timer is set. The wheel measures the time between its ticks, so
+    // the clock keeps running for its lifetime (the millisecond clock is a low-power RTT on most boards).
+    ztimer_acquire(ZTIMER_MSEC);
+    wheel->tick_start = ztimer_now(ZTIMER_MSEC);
+    event_timeout_ztimer_init(&wheel->timeout, ZTIMER_MSEC, queue, &wheel->tick_event);
+}
+
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, event_t *event) {
+    timer->next = NULL;
+    timer->event = event;
+    timer->due = 0;
+    timer->armed = false;
+}
+
+void timer_wheel_set(timer_wheel_t *wheel, timer_wheel_timer_t *timer, const uint32_t delay) {
+    advance(wheel);
+    if (timer->armed) {
+        unlink_timer(wheel, timer);
+    }
+
+    if (delay == 0) {
+        event_post(wheel->queue, timer->event);
+        if (wheel->next_stale) {
+            arm(wheel);
+        }
+        return;
+    }
+
+    // The current tick started already, a delay ends in the tick after the one it falls into
+    const uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - wheel->tick_start;
+    const uint32_t ticks = (uint32_t)(((uint64_t)elapsed + delay + TIMER_WHEEL_TICK - 1) / TIMER_WHEEL_TICK);
+    timer->due = wheel->tick + ticks;
+    timer->armed = true;
+    timer_wheel_timer_t **slot = &wheel->slots[timer->due % TIMER_WHEEL_SLOTS];
+    timer->next = *slot;
+    *slot = timer;
+
+    // Only a timer due before the earliest one moves the ztimer, unless the earliest one left and is searched anyway
+    if (wheel->next_stale) {
+        arm(wheel);
+    } else if (!wheel->next_armed || (int32_t)(timer->due - wheel->next_due) < 0) {
+        wheel->next_due = timer->due;
+        wheel->next_armed = true;
+        arm(wheel);
+    }
+}
+
+void timer_wheel_clear(timer_wheel_t *wheel, timer_wheel_timer_t *timer) {
+    if (timer->armed) {
+        unlink_timer(wheel, timer);
+        if (wheel->next_stale) {
+            arm(wheel);
+        }
+    }
+}
+
+uint32_t timer_wheel_now(const timer_wheel_t *wheel) {
+    // Only reads the wheel, the ticks not processed yet are added
+    const unsigned state = irq_disable();
+    const uint32_t tick = wheel->tick;
+    const uint32_t tick_start = wheel->tick_start;
+    irq_restore(state);
+    return tick + (ztimer_now(ZTIMER_MSEC) - tick_start) / TIMER_WHEEL_TICK;
+}
+
+bool timer_wheel_is_tick(const timer_wheel_t *wheel, const event_t *event) {
+    return event == &wheel->tick_event;
+}
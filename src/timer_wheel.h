@@ -0,0 +1,90 @@
+//
+// Created by vincent on 4/2/25.
+//
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event.h"
+#include "event/timeout.h"
+
+#include "config_constants.h"
+
+/**
+ * Timer of the wheel, posts its event once it expires
+ */
+typedef struct timer_wheel_timer {
+    struct timer_wheel_timer *next;             /**< Next timer in the same slot */
+    event_t *event;                             /**< Event posted when the timer expires */
+    uint32_t due;                               /**< Tick at which the timer expires */
+    bool armed;                                 /**< Whether the timer is in the wheel */
+} timer_wheel_timer_t;
+
+/**
+ * Hashed timer wheel of TIMER_WHEEL_SLOTS slots of TIMER_WHEEL_TICK milliseconds. A timer is stored in the slot of its
+ * due tick, timers further away than one rotation share the slot and wait for their round. Only the next due tick is
+ * armed as ztimer, empty ticks never wake the thread. The next due tick is kept up to date when a timer is set, the
+ * wheel is only searched for it when the earliest timer expired or was cleared.
+ */
+typedef struct {
+    timer_wheel_timer_t *slots[TIMER_WHEEL_SLOTS];  /**< Timers, by due tick modulo TIMER_WHEEL_SLOTS */
+    event_queue_t *queue;                       /**< Queue the events of the expired timers are posted to */
+    event_timeout_t timeout;                    /**< The only armed ztimer, posts tick_event at the next due tick */
+    event_t tick_event;                         /**< Advances the wheel */
+    uint32_t tick;                              /**< Current tick, counted since the initialization */
+    uint32_t tick_start;                        /**< Time of the current tick in milliseconds */
+    uint32_t next_due;                          /**< Due tick of the earliest timer, the ztimer is armed for it */
+    bool next_armed;                            /**< Whether there is a timer in the wheel, i.e. next_due is valid */
+    bool next_stale;                            /**< The earliest timer left the wheel, next_due has to be searched */
+} timer_wheel_t;
+
+/**
+ * Initialize a wheel without any timers. ZTIMER_MSEC is acquired for the lifetime of the wheel, so the elapsed times
+ * measured with it stay valid with ztimer_ondemand.
+ * @param wheel Pointer to the wheel.
+ * @param queue Queue the events of the expired timers are posted to, the wheel itself advances on this queue.
+ */
+void timer_wheel_init(timer_wheel_t *wheel, event_queue_t *queue);
+
+/**
+ * Initialize a timer, which is not armed afterward.
+ * @param timer Pointer to the timer.
+ * @param event Event posted when the timer expires.
+ */
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, event_t *event);
+
+/**
+ * Arm a timer, a timer which is already armed is moved. Has to be called from the thread of the queue.
+ * @param wheel Pointer to the wheel.
+ * @param timer Pointer to the timer.
+ * @param delay Delay in milliseconds, rounded up to whole ticks. Timers due in the same tick expire together.
+ */
+void timer_wheel_set(timer_wheel_t *wheel, timer_wheel_timer_t *timer, uint32_t delay);
+
+/**
+ * Disarm a timer. Has to be called from the thread of the queue.
+ * @param wheel Pointer to the wheel.
+ * @param timer Pointer to the timer.
+ */
+void timer_wheel_clear(timer_wheel_t *wheel, timer_wheel_timer_t *timer);
+
+/**
+ * Get the current tick, it does not wrap for 136 years with ticks of one second. Reads the tick and its start with
+ * disabled interrupts, so it can be called from any thread.
+ * @param wheel Pointer to the wheel.
+ * @return Number of ticks since the initialization.
+ */
+uint32_t timer_wheel_now(const timer_wheel_t *wheel);
+
+/**
+ * Check if an event advances the wheel itself, it belongs to none of the timers.
+ * @param wheel Pointer to the wheel.
+ * @param event The event.
+ * @return Whether the event advances the wheel.
+ */
+bool timer_wheel_is_tick(const timer_wheel_t *wheel, const event_t *event);
+
+#endif //TIMER_WHEEL_H
@@ -0,0 +1,282 @@
+//
+// Created by vincent on 3/22/25.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+
+#include "update_parser.h"
+#include "configuration.h"
+#include "chat_directory.h"
+#include "config_constants.h"
+#include "mem_report.h"
+#include "recipients.h"
+#include "utils/error_handler.h"
+
+// Longest accepted number, 9 digits always fit into an int
+#define UPDATE_NUMBER_DIGITS 9
+
+// Check if a span equals a string literal
+#define SPAN_EQUALS(span, literal) \
+    ((span).len == sizeof(literal) - 1 && memcmp((span).data, literal, sizeof(literal) - 1) == 0)
+
+// Get the part of a span starting at an offset
+static update_span_t span_from(const update_span_t span, const size_t offset) {
+    const update_span_t rest = { span.data + offset, span.len - offset };
+    return rest;
+}
+
+// Find a character in a span, returns its position or the length of the span
+static size_t span_find(const update_span_t span, const char c) {
+    const char *found = memchr(span.data, c, span.len);
+    return found ? (size_t)(found - span.data) : span.len;
+}
+
+// Parse a non-negative decimal number which fills the whole span, unlike atoi nothing is accepted partially
+static bool span_parse_uint(const update_span_t span, int *value) {
+    if (span.len == 0 || span.len > UPDATE_NUMBER_DIGITS) {
+        return false;
+    }
+    int result = 0;
+    for (size_t i = 0; i < span.len; i++) {
+        if (span.data[i] < '0' || span.data[i] > '9') {
+            return false;
+        }
+        result = result * 10 + (span.data[i] - '0');
+    }
+    *value = result;
+    return true;
+}
+
+// Parse a decimal number with an optional minus sign which fills the whole span
+static bool span_parse_int(const update_span_t span, int *value) {
+    const bool negative = span.len > 0 && span.data[0] == '-';
+    if (!span_parse_uint(negative ? span_from(span, 1) : span, value)) {
+        return false;
+    }
+    if (negative) {
+        *value = -*value;
+    }
+    return true;
+}
+
+// Split a span at its commas into at most max fields, returns the number of fields or 0 if there are more
+static uint8_t span_split(update_span_t span, update_span_t *fields, const uint8_t max) {
+    uint8_t count = 0;
+    while (count < max) {
+        const size_t comma = span_find(span, ',');
+        fields[count++] = (update_span_t){ span.data, comma };
+        if (comma == span.len) {
+            return count;
+        }
+        span = span_from(span, comma + 1);
+    }
+    return 0;
+}
+
+// Copy a span into a string for the functions taking strings, longer spans are cut (names are cut anyway)
+static bool span_copy(const update_span_t span, char *buf, const size_t size, const bool cut) {
+    if (span.len >= size && !cut) {
+        return false;
+    }
+    const size_t len = span.len < size ? span.len : size - 1;
+    memcpy(buf, span.data, len);
+    buf[len] = '\0';
+    return true;
+}
+
+bool update_parser_is_status(const update_span_t payload) {
+    return SPAN_EQUALS(payload, "Messages sent successfully") || SPAN_EQUALS(payload, "No Updates");
+}
+
+bool update_parser_session(const update_span_t payload, uint32_t *session_id) {
+    if (payload.len <= 4 || payload.len > 4 + 8 || memcmp(payload.data, "sid=", 4) != 0) {
+        return false;
+    }
+    uint32_t id = 0;
+    for (size_t i = 4; i < payload.len; i++) {
+        const char c = payload.data[i];
+        if (c >= '0' && c <= '9') {
+            id = (id << 4) | (uint32_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            id = (id << 4) | (uint32_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            id = (id << 4) | (uint32_t)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+    *session_id = id;
+    return true;
+}
+
+// Report an invalid command, errors of the configuration functions are reported by themselves
+static int reject(const char *function_name, const int error) {
+    handle_error(function_name, error);
+    return error;
+}
+
+// Add a chat "<name>:<chat ID>"
+static int update_add_chat(const update_span_t command, const size_t colon) {
+    char name[CHAT_NAME_LENGTH];
+    char id[UPDATE_FIELD_LENGTH];
+    int64_t chat_id;
+    const update_span_t name_span = { command.data, colon };
+    if (!span_copy(name_span, name, sizeof(name), true) ||
+        !span_copy(span_from(command, colon + 1), id, sizeof(id), false) || !chat_directory_parse_id(id, &chat_id)) {
+        return reject(__func__, ERROR_INVALID_ARGUMENT);
+    }
+    return config_set_chat_id(name, id);
+}
+
+// Remove a chat by its ID or name "r<chat ID or name>"
+static int update_remove_chat(const update_span_t id_or_name) {
+    char buf[UPDATE_FIELD_LENGTH];
+    if (id_or_name.len == 0 || !span_copy(id_or_name, buf, sizeof(buf), false)) {
+        return reject(__func__, ERROR_INVALID_ARGUMENT);
+    }
+    return config_remove_chat_by_id_or_name(buf);
+}
+
+// Set an alert rule "a<channel>,<kind>,<hundredths>[,<hysteresis>]" or remove it "a<channel>,<kind>,off"
+static int update_alert_rule(const update_span_t arg) {
+    update_span_t fields[4];
+    const uint8_t count = span_split(arg, fields, 4);
+
+    int channel;
+    alert_kind_t kind;
+    if (count < 3 || !span_parse_uint(fields[0], &channel)
+        || channel >= SENSORS_MAX_CHANNELS
+        || (kind = alert_kind_parse(fields[1].data, fields[1].len)) == ALERT_KIND_COUNT) {
+        return reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+    if (SPAN_EQUALS(fields[2], "off")) {
+        return count == 3 ? config_remove_alert_rule(channel, kind) : reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+
+    int limit;
+    int hysteresis = 0;
+    if (!span_parse_int(fields[2], &limit) || (count == 4 && !span_parse_uint(fields[3], &hysteresis))) {
+        return reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+    const alert_rule_t rule = { .limit = limit, .hysteresis = hysteresis, .channel = channel, .kind = kind };
+    return config_set_alert_rule(&rule);
+}
+
+// Set the schedule of a chat "s<chat ID or name>,<minutes>[,<quiet start>,<quiet end>]", times in minutes of the day
+static int update_chat_schedule(const update_span_t arg) {
+    update_span_t fields[4];
+    const uint8_t count = span_split(arg, fields, 4);
+
+    char id_or_name[UPDATE_FIELD_LENGTH];
+    int interval;
+    int quiet_start = CHAT_QUIET_NONE;
+    int quiet_end = CHAT_QUIET_NONE;
+    if ((count != 2 && count != 4) || fields[0].len == 0 || !span_copy(fields[0], id_or_name, sizeof(id_or_name), false)
+        || !span_parse_uint(fields[1], &interval) || interval > UINT16_MAX
+        || (count == 4 && (!span_parse_uint(fields[2], &quiet_start) || !span_parse_uint(fields[3], &quiet_end)
+            || quiet_start > UINT16_MAX || quiet_end > UINT16_MAX))) {
+        return reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+    const chat_schedule_t schedule = { .interval = interval, .quiet_start = quiet_start, .quiet_end = quiet_end };
+    return config_set_chat_schedule(id_or_name, &schedule);
+}
+
+int update_parser_command(const update_span_t command) {
+    if (command.len == 0) {
+        return reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+
+    // Chat names may start with a command letter, only additions contain a colon
+    const size_t colon = span_find(command, ':');
+    if (colon < command.len) {
+        return update_add_chat(command, colon);
+    }
+
+    const update_span_t arg = span_from(command, 1);
+    int value;
+    switch (command.data[0]) {
+        // Changing LED-Feedback to either 0 or 1
+        case 'f':
+            if (!SPAN_EQUALS(arg, "0") && !SPAN_EQUALS(arg, "1")) {
+                return reject(__func__, ERROR_INVALID_ARG_FEEDBACK);
+            }
+            config_set_led_feedback(arg.data[0] == '1');
+            return CONFIG_SUCCESS;
+
+        // Changing the Interval timer
+        case 'i':
+            if (!span_parse_uint(arg, &value) || value < 1) {
+                return reject(__func__, ERROR_INVALID_ARG_INTERVAL);
+            }
+            return config_set_notification_interval(value);
+
+        // Changing the reporting deadband (in hundredths of a unit)
+        case 'd':
+            if (!span_parse_uint(arg, &value)) {
+                return reject(__func__, ERROR_CONFIG_COMMAND);
+            }
+            return config_set_report_deadband(value);
+
+        // Changing the reporting heartbeat (in intervals)
+        case 'h':
+            if (!span_parse_uint(arg, &value)) {
+                return reject(__func__, ERROR_CONFIG_COMMAND);
+            }
+            return config_set_report_heartbeat(value);
+
+        // Setting or removing an alert rule
+        case 'a':
+            return update_alert_rule(arg);
+
+        // Setting the own interval and the quiet window of a chat
+        case 's':
+            return update_chat_schedule(arg);
+
+        // Setting the time of day of the quiet windows (minute of the day)
+        case 't':
+            if (!span_parse_uint(arg, &value)) {
+                return reject(__func__, ERROR_CONFIG_COMMAND);
+            }
+            return recipients_set_clock(value);
+
+        // Sending the stack and buffer usage to every chat
+        case 'm':
+            if (arg.len != 0) {
+                return reject(__func__, ERROR_CONFIG_COMMAND);
+            }
+            mem_report_schedule_send();
+            return CONFIG_SUCCESS;
+
+        // Removing a User from receiving notifications
+        case 'r':
+            return update_remove_chat(arg);
+
+        default:
+            return reject(__func__, ERROR_CONFIG_COMMAND);
+    }
+}
+
+unsigned update_parser_apply(update_span_t payload) {
+    unsigned failed = 0;
+
+    // Semicolons divide the configuration changes, the payload itself is never modified
+    while (payload.len > 0) {
+        const size_t end = span_find(payload, ';');
+        const update_span_t command = { payload.data, end };
+
+        if (command.len > 0) {
+            const int res = update_parser_command(command);
+            if (res == CONFIG_SUCCESS) {
+                LOG_DEBUG("Configuration command applied: %.*s\n", (int)command.len, command.data);
+            } else {
+                LOG_WARNING("Configuration command failed: %.*s\n", (int)command.len, command.data);
+                failed++;
+            }
+        }
+        payload = span_from(payload, end < payload.len ? end + 1 : end);
+    }
+    return failed;
+}
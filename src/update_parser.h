@@ -0,0 +1,56 @@
+//
+// Created by vincent on 3/22/25.
+//
+
+#ifndef UPDATE_PARSER_H
+#define UPDATE_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Longest field of a command that is passed on as string (chat name, chat ID), including the '\0'.
+ * Enough for every 64-bit chat ID with its sign.
+ */
+#define UPDATE_FIELD_LENGTH 21
+
+/**
+ * Read-only view of a part of a response payload, which is not terminated by '\0'
+ */
+typedef struct {
+    const char *data;                           /**< First character, points into the payload */
+    size_t len;                                 /**< Number of characters */
+} update_span_t;
+
+/**
+ * Check if the payload is a status message of the websocket ("Messages sent successfully", "No Updates").
+ * @param payload The payload.
+ * @return Whether the payload is a status message.
+ */
+bool update_parser_is_status(update_span_t payload);
+
+/**
+ * Parse a session registration "sid=<session ID in hex>".
+ * @param payload The payload.
+ * @param session_id Receives the session ID.
+ * @return Whether the payload is a valid session registration.
+ */
+bool update_parser_session(update_span_t payload, uint32_t *session_id);
+
+/**
+ * Apply a single configuration command, e.g. "i30", "f1", "r12345" or "name:12345".
+ * @param command The command, without the separating ';'.
+ * @return CONFIG_SUCCESS or the error of the command.
+ */
+int update_parser_command(update_span_t command);
+
+/**
+ * Apply every command of a configuration update "<command>;<command>;..." in a single pass. A failed command is
+ * reported and skipped, the following commands are still applied.
+ * @param payload The payload.
+ * @return Number of failed commands.
+ */
+unsigned update_parser_apply(update_span_t payload);
+
+#endif //UPDATE_PARSER_H
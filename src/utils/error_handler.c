@@ -5,40 +5,176 @@
 #include <stdio.h>
 #include "error_handler.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "irq.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "ztimer.h"
+
+#if (ERROR_LOG_SIZE & (ERROR_LOG_SIZE - 1)) != 0 || ERROR_LOG_SIZE > 128
+#error "ERROR_LOG_SIZE has to be a power of two of at most 128"
+#endif
+
+// Thread flag set for the thread running run_error_log() when a record was added
+#define ERROR_LOG_FLAG (1u << 0)
+
 // Error lookup table
 typedef struct {
     error_code_t code;
     const char *message;
-    const char *log_level;
+    uint8_t log_level;
 } error_entry_t;
 
+// Record of the log, the message is only looked up when it is printed. __func__ is static, so its address identifies
+// the function.
+typedef struct {
+    uint32_t time;                  // Time of the record in milliseconds
+    const char *function;           // Name of the reporting function
+    uint8_t code;                   // Error code
+    uint8_t suppressed;             // Records of the code dropped by the rate limit before this one
+} error_record_t;
+
 static int last_error = 0;
+static uint16_t error_counts[ERROR_CODE_COUNT];
+
+// Rate limit of each code: start of its window, records in the window and records dropped since the last record
+static uint32_t window_start[ERROR_CODE_COUNT];
+static uint8_t window_records[ERROR_CODE_COUNT];
+static uint8_t suppressed[ERROR_CODE_COUNT];
 
+// Ring buffer of the records, lost counts the records overwritten before they were printed
+static error_record_t records[ERROR_LOG_SIZE];
+static uint8_t record_head;
+static uint8_t record_count;
+static uint16_t records_lost;
+
+static thread_t *flush_thread;
+
+// The table is in the order of the enum, so a code is its index
 static const error_entry_t error_table[] = {
 #define X(code, message, log_level) { code, message, log_level },
     ERROR_LIST
     #undef X
 };
 
+static const char *const level_names[] = { "[NONE]", "[ERROR]", "[WARNING]", "[INFO]", "[DEBUG]" };
+
 // Find error message and log level based on error code
-const error_entry_t *get_error_entry(const error_code_t error_code) {
-    for (uint8_t i = 0; i < sizeof(error_table) / sizeof(error_table[0]); i++) {
-        if (error_table[i].code == error_code) {
-            return &error_table[i];
+static const error_entry_t *get_error_entry(const error_code_t error_code) {
+    if ((unsigned)error_code < ERROR_CODE_COUNT) {
+        return &error_table[error_code];
+    }
+    return &error_table[ERROR_UNKNOWN]; // Default unknown error
+}
+
+// Check the rate limit of a code and count the dropped record, has to be called with disabled interrupts
+static bool rate_limited(const uint8_t code, const uint32_t now) {
+    if (now - window_start[code] >= ERROR_LOG_RATE_WINDOW) {
+        window_start[code] = now;
+        window_records[code] = 0;
+    }
+    if (window_records[code] >= ERROR_LOG_RATE_LIMIT) {
+        if (suppressed[code] < UINT8_MAX) {
+            suppressed[code]++;
         }
+        return true;
     }
-    return &error_table[sizeof(error_table) / sizeof(error_table[0]) - 1]; // Default unknown error
+    window_records[code]++;
+    return false;
 }
 
-// Error handler
-void handle_error(const char *function_name, const error_code_t error_code) {
-    last_error = error_code;
+// Error handler, the level of the code was checked by handle_error()
+void record_error(const char *function_name, const error_code_t error_code) {
     const error_entry_t *entry = get_error_entry(error_code);
-    fprintf(stderr, "%s %s: %s\n", entry->log_level, function_name, entry->message);
+    const uint8_t code = entry->code;
+    const uint32_t now = ztimer_now(ZTIMER_MSEC);
+
+    const unsigned state = irq_disable();
+    last_error = error_code;
+    if ((unsigned)error_code < ERROR_CODE_COUNT && error_counts[error_code] < UINT16_MAX) {
+        error_counts[error_code]++;
+    }
+    if (rate_limited(code, now)) {
+        irq_restore(state);
+        return;
+    }
+
+    error_record_t *record = &records[(record_head + record_count) % ERROR_LOG_SIZE];
+    if (record_count == ERROR_LOG_SIZE) {
+        record_head = (record_head + 1) % ERROR_LOG_SIZE;  // Overwrite the oldest record
+        if (records_lost < UINT16_MAX) {
+            records_lost++;
+        }
+    } else {
+        record_count++;
+    }
+    record->time = now;
+    record->function = function_name;
+    record->code = code;
+    record->suppressed = suppressed[code];
+    suppressed[code] = 0;
+    irq_restore(state);
+
+    if (ERROR_LOG_AUTO_FLUSH && flush_thread) {
+        thread_flags_set(flush_thread, ERROR_LOG_FLAG);
+    }
+}
+
+unsigned flush_error_log(void) {
+    unsigned printed = 0;
+    while (1) {
+        // Take one record at a time, new records may be added while printing
+        const unsigned state = irq_disable();
+        if (record_count == 0) {
+            irq_restore(state);
+            break;
+        }
+        const error_record_t record = records[record_head];
+        const uint16_t lost = records_lost;
+        record_head = (record_head + 1) % ERROR_LOG_SIZE;
+        record_count--;
+        records_lost = 0;
+        irq_restore(state);
+
+        if (lost > 0) {
+            fprintf(stderr, "[WARNING] %u log records lost, the log was full\n", lost);
+        }
+        const error_entry_t *entry = &error_table[record.code];
+        fprintf(stderr, "%s %s: %s (%lu ms)", level_names[entry->log_level], record.function, entry->message,
+            (unsigned long)record.time);
+        if (record.suppressed > 0) {
+            fprintf(stderr, ", %u more suppressed", record.suppressed);
+        }
+        fputc('\n', stderr);
+        printed++;
+    }
+    return printed;
+}
+
+void run_error_log(void) {
+    flush_thread = thread_get(thread_getpid());
+    while (1) {
+        flush_error_log();
+        thread_flags_wait_any(ERROR_LOG_FLAG);
+    }
 }
 
 int get_last_error(void) {
     return last_error;
-}
\ No newline at end of file
+}
+
+uint16_t get_error_count(const error_code_t error_code) {
+    return (unsigned)error_code < ERROR_CODE_COUNT ? error_counts[error_code] : 0;
+}
+
+const char *get_error_message(const error_code_t error_code) {
+    return get_error_entry(error_code)->message;
+}
+
+void reset_error_counts(void) {
+    for (uint8_t i = 0; i < ERROR_CODE_COUNT; i++) {
+        error_counts[i] = 0;
+    }
+}
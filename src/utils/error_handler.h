@@ -5,32 +5,77 @@
 #ifndef ERROR_HANDLER_H
 #define ERROR_HANDLER_H
 
+#include <stdint.h>
+
+#include "log.h"
+
+/**
+ * Number of records kept until they are printed, a power of two. When the log is full, the oldest record is lost.
+ */
+#ifndef ERROR_LOG_SIZE
+#define ERROR_LOG_SIZE 32
+#endif
+
+/**
+ * Records of one code per ERROR_LOG_RATE_WINDOW ms, further records are only counted
+ */
+#ifndef ERROR_LOG_RATE_LIMIT
+#define ERROR_LOG_RATE_LIMIT 4
+#endif
+
+#ifndef ERROR_LOG_RATE_WINDOW
+#define ERROR_LOG_RATE_WINDOW 10000
+#endif
+
 /**
- * Error definition
+ * Print the records as soon as the thread running run_error_log() is idle, otherwise only with flush_error_log()
+ */
+#ifndef ERROR_LOG_AUTO_FLUSH
+#define ERROR_LOG_AUTO_FLUSH 1
+#endif
+
+/**
+ * Error definition, the log level of each code is one of the RIOT-OS log levels
  */
 #define ERROR_LIST \
-X(COAP_SUCCESS, "CoAP message send successful to server", "[INFO]") \
-X(COAP_PKT_SUCCESS, "CoAP package created successful", "[INFO]") \
-X(LED_SUCCESS, "LED operation successful", "[INFO]") \
-X(TEMP_SUCCESS, "Temperature operation successful", "[INFO]") \
-X(ERROR_INVALID_ARGUMENT, "Invalid argument provided to function", "[ERROR]") \
-X(ERROR_INVALID_ARG_INTERVAL, "Interval must be a positive number", "[ERROR]") \
-X(ERROR_INVALID_ARG_FEEDBACK, "Feedback must be 0 (off) or 1 (on)", "[ERROR]") \
-X(ERROR_INVALID_ARG_PORT, "Port must be a valid number (1-65535)", "[ERROR]") \
-X(ERROR_COAP_INIT, "CoAP packet initialization failed", "[ERROR]") \
-X(ERROR_COAP_URI_PATH, "Unable to append URI path in CoAP request", "[ERROR]") \
-X(ERROR_COAP_PAYLOAD, "Payload appending to CoAP request failed", "[ERROR]") \
-X(ERROR_COAP_TIMEOUT, "CoAP request timeout", "[ERROR]") \
-X(ERROR_IPV6_FORMAT, "Invalid IPv6 address format encountered", "[ERROR]") \
-X(ERROR_COAP_SEND, "CoAP request transmission failed", "[ERROR]") \
-X(ERROR_CHAT_ID_NOT_FOUND, "Chat with this ID/person does not exist", "[ERROR]") \
-X(ERROR_ALLOC_MEMORY_FAIL, "Memory allocation failure detected", "[ERROR]") \
-X(ERROR_NO_SENSOR, "Sensor not found or unavailable", "[ERROR]") \
-X(ERROR_TEMP_READ_FAIL, "Temperature data read operation failed", "[ERROR]") \
-X(ERROR_LED_WRITE, "Unable to write LED state", "[ERROR]") \
-X(ERROR_NULL_POINTER, "NULL pointer detected in function call", "[ERROR]") \
-X(ERROR_CALLER_UNKNOWN, "Unknown caller function", "[ERROR]") \
-X(ERROR_UNKNOWN, "An unknown error occurred", "[ERROR]")
+X(COAP_SUCCESS, "CoAP message send successful to server", LOG_INFO) \
+X(COAP_PKT_SUCCESS, "CoAP package created successful", LOG_DEBUG) \
+X(LED_SUCCESS, "LED operation successful", LOG_INFO) \
+X(TEMP_SUCCESS, "Temperature operation successful", LOG_INFO) \
+X(CONFIG_SUCCESS, "Configuration change successful", LOG_INFO) \
+X(ERROR_INVALID_ARGUMENT, "Invalid argument provided to function", LOG_ERROR) \
+X(ERROR_INVALID_ARG_INTERVAL, "Interval must be a positive number", LOG_ERROR) \
+X(ERROR_INVALID_ARG_FEEDBACK, "Feedback must be 0 (off) or 1 (on)", LOG_ERROR) \
+X(ERROR_INVALID_ARG_PORT, "Port must be a valid number (1-65535)", LOG_ERROR) \
+X(ERROR_INVALID_ARG_BATCH, "Batch size must be between 1 and the sample buffer size", LOG_ERROR) \
+X(ERROR_COAP_INIT, "CoAP packet initialization failed", LOG_ERROR) \
+X(ERROR_COAP_URI_PATH, "Unable to append URI path in CoAP request", LOG_ERROR) \
+X(ERROR_COAP_PAYLOAD, "Payload appending to CoAP request failed", LOG_ERROR) \
+X(ERROR_COAP_TIMEOUT, "CoAP request timeout", LOG_ERROR) \
+X(ERROR_IPV6_FORMAT, "Invalid IPv6 address format encountered", LOG_ERROR) \
+X(ERROR_COAP_SEND, "CoAP request transmission failed", LOG_ERROR) \
+X(ERROR_COAP_RESPONSE, "CoAP server responded with an error", LOG_ERROR) \
+X(ERROR_COAP_SESSION, "CoAP session unknown to server, registering again", LOG_ERROR) \
+X(ERROR_COAP_BUSY, "No free CoAP request slot, too many requests in flight", LOG_ERROR) \
+X(ERROR_COAP_TRUNCATED, "CoAP response truncated, its last command is skipped", LOG_ERROR) \
+X(ERROR_STARTUP_TIMEOUT, "Network not ready before the startup timeout, sending anyway", LOG_ERROR) \
+X(ERROR_RADIO_STATE, "Unable to switch the radio between sleep and idle", LOG_ERROR) \
+X(ERROR_OUTBOX_FULL, "Outbox full, oldest undelivered sample dropped", LOG_ERROR) \
+X(ERROR_OUTBOX_FLASH, "Outbox flash overflow access failed", LOG_ERROR) \
+X(ERROR_CHAT_ID_NOT_FOUND, "Chat with this ID/person does not exist", LOG_ERROR) \
+X(ERROR_CHAT_DIRECTORY_FULL, "No space left for another chat in the chat directory", LOG_ERROR) \
+X(ERROR_CHAT_SCHEDULE_FULL, "No space left for the schedule of another chat", LOG_ERROR) \
+X(ERROR_CONFIG_STORE, "Configuration store unavailable or flash access failed", LOG_ERROR) \
+X(ERROR_CONFIG_COMMAND, "Unknown or malformed configuration command", LOG_ERROR) \
+X(ERROR_ALERT_RULE, "Invalid alert rule or no space left for another rule", LOG_ERROR) \
+X(ERROR_ALLOC_MEMORY_FAIL, "Memory allocation failure detected", LOG_ERROR) \
+X(ERROR_NO_SENSOR, "Sensor not found or unavailable", LOG_ERROR) \
+X(ERROR_TEMP_READ_FAIL, "Temperature data read operation failed", LOG_ERROR) \
+X(ERROR_SENSOR_READ_FAIL, "Sensor data read operation failed", LOG_ERROR) \
+X(ERROR_LED_WRITE, "Unable to write LED state", LOG_ERROR) \
+X(ERROR_NULL_POINTER, "NULL pointer detected in function call", LOG_ERROR) \
+X(ERROR_CALLER_UNKNOWN, "Unknown caller function", LOG_ERROR) \
+X(ERROR_UNKNOWN, "An unknown error occurred", LOG_ERROR)
 
 /**
  * Convert the list of errors to an enum
@@ -41,13 +86,57 @@ typedef enum {
     #undef X
 } error_code_t;
 
+/**
+ * Number of error codes, ERROR_UNKNOWN is always the last one
+ */
+#define ERROR_CODE_COUNT (ERROR_UNKNOWN + 1)
+
+/**
+ * Get the log level of an error code, the level of a constant code is resolved at compile time
+ * @param error_code The error code.
+ * @return RIOT-OS log level of the code.
+ */
+static inline uint8_t get_error_level(const error_code_t error_code) {
+    switch (error_code) {
+#define X(code, message, log_level) case code: return log_level;
+        ERROR_LIST
+        #undef X
+    }
+    return LOG_ERROR;
+}
+
+/**
+ * Count an error code and record it in the log, use handle_error() instead.
+ * @param function_name Name of the function reporting the error, has to be static like __func__.
+ * @param error_code The error code to record.
+ */
+void record_error(const char *function_name, error_code_t error_code);
+
 /**
  * Handles errors based on the error code.
- * Logs an appropriate message.
- * @param function_name Name of the function reporting the error.
+ * Counts the code and records it in the log. Codes above LOG_LEVEL are dropped, for a constant code the call is
+ * removed at compile time. Nothing is printed here, the records are printed by run_error_log() or flush_error_log().
+ * @param function_name Name of the function reporting the error, has to be static like __func__.
  * @param error_code The error code to handle.
  */
-void handle_error(const char *function_name, error_code_t error_code);
+static inline void handle_error(const char *function_name, const error_code_t error_code) {
+    if (get_error_level(error_code) <= LOG_LEVEL) {
+        record_error(function_name, error_code);
+    }
+}
+
+/**
+ * Print the recorded messages and remove them from the log.
+ * @return Number of printed records.
+ */
+unsigned flush_error_log(void);
+
+/**
+ * Print the recorded messages whenever records are added, never returns. Has to run in a thread with a lower priority
+ * than all threads handling errors (the main thread drops to THREAD_PRIORITY_MIN - 1), so the printing happens while
+ * they are idle.
+ */
+void run_error_log(void);
 
 /**
  * Simple command to get the last error message
@@ -55,5 +144,24 @@ void handle_error(const char *function_name, error_code_t error_code);
  */
 int get_last_error(void);
 
+/**
+ * Get how often an error code was handled since the boot or the last reset
+ * @param error_code The error code.
+ * @return Number of times the error code was handled.
+ */
+uint16_t get_error_count(error_code_t error_code);
+
+/**
+ * Get the message of an error code
+ * @param error_code The error code.
+ * @return Message of the error code.
+ */
+const char *get_error_message(error_code_t error_code);
+
+/**
+ * Reset the counts of all error codes
+ */
+void reset_error_counts(void);
+
 #endif // ERROR_HANDLER_H
 
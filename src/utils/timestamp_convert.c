@@ -7,7 +7,7 @@
 #include "timestamp_convert.h"
 
 void format_timestamp(const uint32_t timestamp, char *buffer, const size_t buffer_size) {
-    const uint32_t total_seconds = timestamp / 1000000; // Convert microseconds to seconds
+    const uint32_t total_seconds = timestamp / 1000; // Convert milliseconds to seconds
     const uint16_t hours = total_seconds / 3600;
     const uint16_t minutes = (total_seconds % 3600) / 60;
     const uint16_t seconds = total_seconds % 60;
@@ -8,8 +8,8 @@
 #include <stdint.h>
 
 /**
- * Converts a standard timestamp from microseconds to the format [hh:mm:ss]
- * @param timestamp The timestamp in microseconds
+ * Converts a standard timestamp from milliseconds to the format [hh:mm:ss]
+ * @param timestamp The timestamp in milliseconds
  * @param buffer Pointer to the formatted output
  * @param buffer_size Size of the output
  */
@@ -3,8 +3,10 @@ import os
 import logging
 
 import aiocoap
+import cbor2
 import httpx
 import re
+import secrets
 import time
 from aiocoap import resource, Code
 from dotenv import load_dotenv
@@ -34,13 +36,149 @@ coap_server_ip = os.getenv("COAP_SERVER_IP", "::1")  # Default to localhost (::1
 logging.info(f"Using CoAP server IP: {coap_server_ip}")
 start_time = int(time.time())
 
+# Interval in seconds to poll Telegram for the sessions observing /config
+config_poll_interval = int(os.getenv("CONFIG_POLL_INTERVAL", "10"))
+
+# Map the RIOT-OS phydat_t unit enumerators to strings
+UNIT_STRINGS = {0: "", 1: "", 2: "°C", 3: "°F", 4: "K"}
+
+
+# Content-Format of CBOR encoded requests, see RFC 7049
+CONTENT_FORMAT_CBOR = 60
+# Map the integer keys of CBOR encoded requests to the field names of form encoded requests
+CBOR_KEYS = {0: "url", 1: "token", 2: "chat_ids", 3: "text", 4: "samples", 5: "sid", 6: "updates"}
+
+
+def parse_samples(samples):
+    """Parses a batch '<device>,<scale>,<unit>[,<quantity>,<unit symbol>];<age>:<value>;...' into
+    [device, scale, unit, [[age, value], ...], quantity, unit symbol], the groups of several channels are separated
+    by '|' and parsed into a list of groups. Summaries '<age>:<mean>:<min>:<max>:<count>' keep all their fields."""
+    groups = []
+    for group in samples.replace("\x00", "").strip().split("|"):
+        header, *entries = group.split(";")
+        device, scale, unit, *extra = header.split(",")
+        groups.append([device, int(scale), int(unit), [[int(x) for x in entry.split(":")] for entry in entries], *extra])
+    return groups[0] if len(groups) == 1 else groups
+
+
+def decode_request(request):
+    """Decodes a request payload, either a CBOR map (Content-Format CBOR) or a form string 'key=value&...'"""
+    if request.opt.content_format == CONTENT_FORMAT_CBOR:
+        data = {CBOR_KEYS.get(key, key): value for key, value in cbor2.loads(request.payload).items()}
+        if "chat_ids" in data:
+            data["chat_ids"] = ",".join(str(chat_id) for chat_id in data["chat_ids"])
+        return data
+
+    payload = request.payload.decode("utf-8")
+    data = {k: v for k, v in (item.split("=") for item in payload.split("&"))}
+    if data.get("samples"):
+        data["samples"] = parse_samples(data["samples"])
+    if data.get("sid"):
+        data["sid"] = int(data["sid"], 16)
+    return data
+
+
+class SessionStore:
+    """Stores the credentials and chat lists of registered devices, so requests only have to carry a session ID"""
+
+    def __init__(self, max_sessions=32):
+        self.sessions = {}
+        self.max_sessions = max_sessions
+
+    def register(self, url, token, chat_ids):
+        """Creates a new session and returns its ID"""
+        if len(self.sessions) >= self.max_sessions:
+            del self.sessions[next(iter(self.sessions))]  # Drop the oldest session
+        session_id = secrets.randbits(32)
+        while session_id in self.sessions:
+            session_id = secrets.randbits(32)
+        self.sessions[session_id] = {"url": url, "token": token, "chat_ids": chat_ids}
+        return session_id
+
+    def resolve(self, data):
+        """Fills in the credentials and chat IDs of a request from its session, returns False for unknown sessions"""
+        if "sid" not in data:
+            return True
+        session = self.sessions.get(data["sid"])
+        if session is None:
+            return False
+        data["url"] = session["url"]
+        data["token"] = session["token"]
+        if not data.get("chat_ids"):
+            data["chat_ids"] = session["chat_ids"]
+        return True
+
+
+sessions = SessionStore()
+
+
+class CoAPResourceRegister(resource.Resource):
+    """CoAP Resource to register a device session"""
+
+    async def render_post(self, request):
+        try:
+            data = decode_request(request)
+
+            telegram_api_url = data.get("url", "").strip()
+            telegram_bot_token = data.get("token", "").strip()
+            chat_ids = data.get("chat_ids", "").strip()
+
+            if not telegram_api_url or not telegram_bot_token:
+                logging.error("Missing required fields in registration")
+                return aiocoap.Message(code=Code.BAD_REQUEST, payload=b"Missing required fields")
+
+            session_id = sessions.register(telegram_api_url, telegram_bot_token, chat_ids)
+            logging.info(f"Registered session {session_id:08x}: url='{telegram_api_url}', bot_token=[HIDDEN], chat_ids={chat_ids}")
+            return aiocoap.Message(code=Code.CREATED, payload=f"sid={session_id:08x}".encode("utf-8"))
+
+        except Exception as e:
+            logging.exception("Exception occurred while registering session")
+            return aiocoap.Message(
+                code=Code.INTERNAL_SERVER_ERROR,
+                payload=f"Internal server error: {str(e)}".encode("utf-8"),
+            )
+
+
+def expand_samples(samples, now=None):
+    """Expands a batch [device, scale, unit, [[age, value], ...]] (or a list of these groups, one per sensor channel)
+    into one text line per sample, oldest first. Summaries [age, mean, min, max, count] add their range."""
+    now = now if now is not None else int(time.time())
+    groups = samples if isinstance(samples[0], list) else [samples]
+
+    lines = []
+    for device, scale, unit, entries, *extra in groups:
+        quantity = extra[0] if extra else "Temperature"
+        unit_string = extra[1] if len(extra) > 1 else UNIT_STRINGS.get(unit, "")
+        digits = -scale if scale < 0 else 0
+        for age, value, *window in entries:
+            reading = value * (10 ** scale)
+            timestamp = time.strftime("%H:%M", time.localtime(now - age))
+            line = f"[{timestamp}] {device} {quantity}: {reading:.{digits}f} {unit_string}".rstrip()
+            if len(window) == 3:
+                low, high, count = window
+                line += f" (min {low * (10 ** scale):.{digits}f}, max {high * (10 ** scale):.{digits}f}, {count} readings)"
+            lines.append((age, line))
+    return [line for _, line in sorted(lines, key=lambda entry: -entry[0])]
+
 
 class CoAPResource(resource.Resource):
     """CoAP Resource to handle telegram POST requests"""
+
+    def __init__(self, updates):
+        super().__init__()
+        self.updates = updates                                      # Resource processing the Telegram updates
+
+    async def needs_blockwise_assembly(self, request):
+        """Long messages and large sample batches arrive block-wise (Block1), aiocoap reassembles them before
+        render_post is called and answers the intermediate blocks with 2.31 Continue"""
+        return True
+
     async def render_post(self, request):
         try:
-            payload = request.payload.decode("utf-8")
-            data = {k: v for k, v in (item.split("=") for item in payload.split("&"))}
+            data = decode_request(request)
+            if not sessions.resolve(data):
+                logging.warning(f"Unknown session {data['sid']:08x}, requesting registration")
+                return aiocoap.Message(code=Code.UNAUTHORIZED, payload=b"Unknown session")
 
             telegram_api_url = data.get("url", "").strip()
             telegram_bot_token = data.get("token", "").strip()
@@ -48,6 +186,11 @@ class CoAPResource(resource.Resource):
             text = data.get("text", "").strip()
             text = text.replace("\x00", "").replace("\n", "")
 
+            # A batch of samples is expanded into one line per sample
+            samples = data.get("samples")
+            if samples and not text:
+                text = "\n".join(expand_samples(samples))
+
             if not telegram_api_url or not telegram_bot_token or not chat_ids or not text:
                 logging.error("Missing required fields in request")
                 logging.error(f"url='{telegram_api_url}', bot_token=[HIDDEN], chat_ids={chat_ids}, text='{text}'")
@@ -69,6 +212,12 @@ class CoAPResource(resource.Resource):
                     else:
                         logging.error(f"Telegram API error for {chat_id}: {response.text}")
 
+            # Piggyback pending configuration updates on the response, this saves the device a separate /update call
+            if data.get("updates") in (True, "1"):
+                compact_message = await self.updates.fetch_updates(data["url"].strip(), telegram_bot_token)
+                if compact_message:
+                    return aiocoap.Message(code=Code.CONTENT, payload=compact_message)
+
             return aiocoap.Message(code=Code.CONTENT, payload=b"Messages sent successfully")
 
         except Exception as e:
@@ -86,14 +235,17 @@ class CoAPResourceGet(resource.Resource):
         super().__init__()
         self.last_update = start_time                               # Track the system time
         self.chats = {}                                             # Store chats as a list <- max 10
-        self.latest_values = {"interval": 2, "feedback": 0}         # Store latest config values
+        self.latest_values = {"interval": 2, "feedback": 0,         # Store latest config values
+                              "deadband": 0, "heartbeat": 12}
         self.password = telegram_password                           # Telegram password
         self.update_storage_threshold = 50                          # The maximum number of updates stored on server
 
     async def render_post(self, request):
         try:
-            payload = request.payload.decode("utf-8")
-            data = {k: v for k, v in (item.split("=") for item in payload.split("&"))}
+            data = decode_request(request)
+            if not sessions.resolve(data):
+                logging.warning(f"Unknown session {data['sid']:08x}, requesting registration")
+                return aiocoap.Message(code=Code.UNAUTHORIZED, payload=b"Unknown session")
 
             telegram_api_url = data.get("url", "").strip()
             telegram_bot_token = data.get("token", "").strip()
@@ -105,102 +257,139 @@ class CoAPResourceGet(resource.Resource):
                 logging.error("Missing required fields in request")
                 return aiocoap.Message(code=Code.BAD_REQUEST, payload=b"Missing required fields")
 
-            # Step 3: Make the API call to get updates from Telegram
-            async with httpx.AsyncClient() as client:
-                response = await client.get(f"{telegram_api_url}{telegram_bot_token}/getUpdates")
-
-                if response.status_code != 200:
-                    logging.error(f"Failed to fetch updates: {response.text}")
-                    return aiocoap.Message(code=Code.INTERNAL_SERVER_ERROR, payload=b"Failed to fetch updates")
-
-                data = response.json()
-                updated_values = {}
-                removal_chat_id = None
-                added_chats = {}
-
-                # Step 4: Process Telegram updates (without update_id)
-                for update in data.get("result", []):
-                    message = update.get("message", {})
-                    text = message.get("text", "").strip()
-                    chat_id = message.get("chat", {}).get("id", "")
-                    first_name = message.get("chat", {}).get("first_name", "")
-                    timestamp = message.get("date", None)
-
-                    if not text:
-                        continue
+            compact_message = await self.fetch_updates(telegram_api_url, telegram_bot_token)
+            if compact_message is None:
+                return aiocoap.Message(code=Code.INTERNAL_SERVER_ERROR, payload=b"Failed to fetch updates")
+            if compact_message:
+                return aiocoap.Message(code=Code.CONTENT, payload=compact_message)
 
-                    if timestamp and int(timestamp) > self.last_update:
-                        # Handle "remove me"
-                        print(f"test {timestamp}")
-                        if text.lower() == "remove me":
-                            if chat_id in self.chats:
-                                removal_chat_id = chat_id
-                                del self.chats[chat_id]
-                                await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "You have been removed.")
-                            else:
-                                await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "You are not in the list.")
-                            continue
+            # If nothing changed, return "No Updates"
+            logging.info("No changes detected, nothing sent via CoAP.")
+            return aiocoap.Message(code=Code.VALID, payload=b"No Updates")
 
-                    # Handle new user registration
-                    if chat_id and first_name and chat_id not in self.chats:
-                        added_chats[chat_id] = first_name
+        except Exception as e:
+            logging.exception("Exception occurred while fetching updates")
+            return aiocoap.Message(
+                code=Code.INTERNAL_SERVER_ERROR,
+                payload=f"Internal server error: {str(e)}".encode("utf-8"),
+            )
 
-                    # Process "config" messages
-                    if not text.lower().startswith("config "):
+    async def fetch_updates(self, telegram_api_url, telegram_bot_token):
+        """Fetches the Telegram updates and returns the encoded configuration changes, b"" if nothing changed and
+        None if the updates could not be fetched"""
+        # Step 3: Make the API call to get updates from Telegram
+        async with httpx.AsyncClient() as client:
+            response = await client.get(f"{telegram_api_url}{telegram_bot_token}/getUpdates")
+
+            if response.status_code != 200:
+                logging.error(f"Failed to fetch updates: {response.text}")
+                return None
+
+            data = response.json()
+            updated_values = {}
+            removal_chat_id = None
+            added_chats = {}
+
+            # Step 4: Process Telegram updates (without update_id)
+            for update in data.get("result", []):
+                message = update.get("message", {})
+                text = message.get("text", "").strip()
+                chat_id = message.get("chat", {}).get("id", "")
+                first_name = message.get("chat", {}).get("first_name", "")
+                timestamp = message.get("date", None)
+
+                if not text:
+                    continue
+
+                if timestamp and int(timestamp) > self.last_update:
+                    # Handle "remove me"
+                    print(f"test {timestamp}")
+                    if text.lower() == "remove me":
+                        if chat_id in self.chats:
+                            removal_chat_id = chat_id
+                            del self.chats[chat_id]
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "You have been removed.")
+                        else:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "You are not in the list.")
                         continue
 
-                    # Extract message components
-                    parts = text.split(" ", 3)
-                    if len(parts) < 4:
-                        continue
+                # Handle new user registration
+                if chat_id and first_name and chat_id not in self.chats:
+                    added_chats[chat_id] = first_name
+
+                # Process "config" messages
+                if not text.lower().startswith("config "):
+                    continue
+
+                # Extract message components
+                parts = text.split(" ", 3)
+                if len(parts) < 4:
+                    continue
+
+                _, password, name, value = parts
+
+                if password != self.password:
+                    logging.warning(f"Invalid password received: {password}")
+                    #await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid password.")
+                    continue
+
+                if timestamp and int(timestamp) > self.last_update:
+                    # Validate input values before updating
+                    if name == "interval":
+                        try:
+                            interval_value = int(value)
+                            if not (1 <= interval_value <= 120):
+                                raise ValueError
+                            if interval_value != self.latest_values["interval"]:
+                                updated_values["interval"] = interval_value
+                        except ValueError:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid interval. Must be between 1 and 120.")
+                            continue
 
-                    _, password, name, value = parts
+                    elif name == "feedback":
+                        if value not in ["0", "1"]:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid feedback. Must be 0 or 1.")
+                            continue
+                        if value != self.latest_values["feedback"]:
+                            updated_values["feedback"] = value
+
+                    elif name in ("deadband", "heartbeat"):
+                        try:
+                            policy_value = int(value)
+                            if not (0 <= policy_value <= 10000):
+                                raise ValueError
+                            if policy_value != self.latest_values[name]:
+                                updated_values[name] = policy_value
+                        except ValueError:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, f"Invalid {name}. Must be between 0 and 10000.")
+                            continue
 
-                    if password != self.password:
-                        logging.warning(f"Invalid password received: {password}")
-                        #await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid password.")
-                        continue
+                    elif name == "alert":
+                        # "<channel> <above|below|rise|fall> <hundredths|off> [hysteresis]"
+                        rule = self._encode_alert(value.split())
+                        if rule is None:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid alert. Use: <channel> <above|below|rise|fall> <hundredths|off> [hysteresis]")
+                            continue
+                        updated_values.setdefault("alert", []).append(rule)
 
-                    if timestamp and int(timestamp) > self.last_update:
-                        # Validate input values before updating
-                        if name == "interval":
-                            try:
-                                interval_value = int(value)
-                                if not (1 <= interval_value <= 120):
-                                    raise ValueError
-                                if interval_value != self.latest_values["interval"]:
-                                    updated_values["interval"] = interval_value
-                            except ValueError:
-                                await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid interval. Must be between 1 and 120.")
-                                continue
-
-                        elif name == "feedback":
-                            if value not in ["0", "1"]:
-                                await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid feedback. Must be 0 or 1.")
-                                continue
-                            if value != self.latest_values["feedback"]:
-                                updated_values["feedback"] = value
-
-                # Step 5: If a change occurred, send update
-                if updated_values or added_chats or removal_chat_id is not None:
-                    print(f"Telegram timestamp: {timestamp}, self.timestamp: {self.last_update}")
-                    self._fancy_logging(self.latest_values, removal_chat_id, added_chats)
-                    self.latest_values.update(updated_values)  # Update latest stored values
-                    self.chats.update(added_chats) # Update chat IDs
-                    self.last_update = int(time.time())  # Update the timestamp as soon as a change occurs
-                    compact_message = self._encode_message(updated_values, removal_chat_id, added_chats)
-                    return aiocoap.Message(code=Code.CONTENT, payload=compact_message)
+                    elif name == "schedule":
+                        # "<minutes> [HH:MM-HH:MM]" for the chat sending the message
+                        schedule = self._encode_schedule(chat_id, value.split())
+                        if schedule is None:
+                            await self._notify_user(telegram_api_url, telegram_bot_token, chat_id, "Invalid schedule. Use: <minutes> [HH:MM-HH:MM]")
+                            continue
+                        updated_values.setdefault("schedule", []).append(schedule)
 
-                # Step 6: If nothing changed, return "No Updates"
-                logging.info("No changes detected, nothing sent via CoAP.")
-                return aiocoap.Message(code=Code.VALID, payload=b"No Updates")
+            # Step 5: If a change occurred, send update
+            if updated_values or added_chats or removal_chat_id is not None:
+                print(f"Telegram timestamp: {timestamp}, self.timestamp: {self.last_update}")
+                self._fancy_logging(self.latest_values, removal_chat_id, added_chats)
+                self.latest_values.update(updated_values)  # Update latest stored values
+                self.chats.update(added_chats) # Update chat IDs
+                self.last_update = int(time.time())  # Update the timestamp as soon as a change occurs
+                return self._encode_message(updated_values, removal_chat_id, added_chats)
 
-        except Exception as e:
-            logging.exception("Exception occurred while fetching updates")
-            return aiocoap.Message(
-                code=Code.INTERNAL_SERVER_ERROR,
-                payload=f"Internal server error: {str(e)}".encode("utf-8"),
-            )
+            return b""
 
     def _encode_message(self, updates, removal_chat_id, added_chats):
         """Encodes updates into a compact byte string for CoAP"""
@@ -212,16 +401,68 @@ class CoAPResourceGet(resource.Resource):
         if "feedback" in updates:
             encoded_list.append(f"f{updates['feedback']}")  # Use "f" for feedback
 
+        if "deadband" in updates:
+            encoded_list.append(f"d{updates['deadband']}")  # Use "d" for the reporting deadband
+
+        if "heartbeat" in updates:
+            encoded_list.append(f"h{updates['heartbeat']}")  # Use "h" for the reporting heartbeat
+
+        for rule in updates.get("alert", []):
+            encoded_list.append(rule)  # Use "a" for the alert rules, already encoded
+
         if added_chats:  # Encode chats in the format "first_name1:chat_id_1;first_name_2:chat_id_2;..."
             chat_string = ";".join([f"{first_name}:{chat_id}" for chat_id, first_name in added_chats.items()])
             encoded_list.append(chat_string)
 
+        for schedule in updates.get("schedule", []):
+            encoded_list.append(schedule)  # Use "s" for the chat schedules, after the chats they belong to
+
         if removal_chat_id:
             encoded_list.append(f"r{removal_chat_id}")
 
+        if encoded_list:
+            now = time.localtime()
+            encoded_list.append(f"t{now.tm_hour * 60 + now.tm_min}")  # Use "t" for the time of day of the quiet windows
+
         encoded_string = ";".join(encoded_list)  # Separate multiple updates with ";"
         return encoded_string.encode("utf-8")
 
+    @staticmethod
+    def _encode_alert(fields):
+        """Encodes an alert rule as "a<channel>,<kind>,<hundredths>[,<hysteresis>]", None if it is invalid"""
+        if not 3 <= len(fields) <= 4 or fields[1] not in ("above", "below", "rise", "fall"):
+            return None
+        try:
+            channel = int(fields[0])
+            if fields[2] == "off":
+                return f"a{channel},{fields[1]},off" if len(fields) == 3 else None
+            numbers = [int(field) for field in fields[2:]]
+        except ValueError:
+            return None
+        if channel < 0 or (len(numbers) == 2 and numbers[1] < 0):
+            return None
+        return f"a{channel},{fields[1]}," + ",".join(str(number) for number in numbers)
+
+    @staticmethod
+    def _encode_schedule(chat_id, fields):
+        """Encodes a chat schedule as "s<chat ID>,<minutes>[,<quiet start>,<quiet end>]", None if it is invalid"""
+        if not 1 <= len(fields) <= 2:
+            return None
+        try:
+            minutes = int(fields[0])
+            window = []
+            if len(fields) == 2:
+                for time_of_day in fields[1].split("-"):
+                    hours, mins = (int(part) for part in time_of_day.split(":"))
+                    if not (0 <= hours < 24 and 0 <= mins < 60):
+                        return None
+                    window.append(hours * 60 + mins)
+        except ValueError:
+            return None
+        if not 0 <= minutes <= 10000 or len(window) not in (0, 2):
+            return None
+        return f"s{chat_id},{minutes}" + "".join(f",{minute}" for minute in window)
+
     def _remove_user(self, chat_id):
         """Remove a user by chat_id from chats"""
         if chat_id in self.chats:
@@ -258,6 +499,90 @@ class CoAPResourceGet(resource.Resource):
         except Exception as e:
             logging.error(f"Failed to send notification to {chat_id}: {e}")
 
+class CoAPResourceConfig(resource.ObservableResource):
+    """Observable CoAP Resource to push configuration updates to the devices, instead of polling /update every cycle"""
+
+    def __init__(self, updates):
+        super().__init__()
+        self.updates = updates                                      # Resource processing the Telegram updates
+        self.observers = {}                                         # Number of observations per session ID
+        self.pending = {}                                           # Configuration changes not yet sent per session
+
+    @staticmethod
+    def _session_id(request):
+        """Gets the session ID from the query '?sid=<session ID in hex>'"""
+        for query in request.opt.uri_query:
+            key, _, value = query.partition("=")
+            if key == "sid" and value:
+                return int(value, 16)
+        return None
+
+    async def add_observation(self, request, serverobservation):
+        """Tracks the observed sessions, only those are polled for updates"""
+        session_id = self._session_id(request)
+        if session_id is None:
+            return
+        self.observers[session_id] = self.observers.get(session_id, 0) + 1
+
+        def _cancel():
+            self.observers[session_id] -= 1
+            if self.observers[session_id] <= 0:
+                del self.observers[session_id]
+                self.pending.pop(session_id, None)
+            logging.info(f"Session {session_id:08x} stopped observing the configuration")
+
+        serverobservation.accept(_cancel)
+        logging.info(f"Session {session_id:08x} is observing the configuration")
+
+    async def render_get(self, request):
+        try:
+            session_id = self._session_id(request)
+            if session_id is None or session_id not in sessions.sessions:
+                logging.warning("Unknown session observing the configuration, requesting registration")
+                return aiocoap.Message(code=Code.UNAUTHORIZED, payload=b"Unknown session")
+
+            # Without an observation (plain GET), fetch the updates directly
+            if session_id not in self.observers:
+                await self.poll_session(session_id)
+
+            compact_message = self.pending.pop(session_id, b"")
+            if compact_message:
+                return aiocoap.Message(code=Code.CONTENT, payload=compact_message)
+            return aiocoap.Message(code=Code.CONTENT, payload=b"No Updates")
+
+        except Exception as e:
+            logging.exception("Exception occurred while rendering configuration")
+            return aiocoap.Message(
+                code=Code.INTERNAL_SERVER_ERROR,
+                payload=f"Internal server error: {str(e)}".encode("utf-8"),
+            )
+
+    async def poll_session(self, session_id):
+        """Fetches the Telegram updates of a session and queues them, returns True if there are new changes"""
+        session = sessions.sessions.get(session_id)
+        if session is None:
+            return False
+        compact_message = await self.updates.fetch_updates(session["url"], session["token"])
+        if not compact_message:
+            return False
+        previous = self.pending.get(session_id)
+        self.pending[session_id] = previous + b";" + compact_message if previous else compact_message
+        return True
+
+    async def poll(self, interval):
+        """Periodically polls Telegram for the observed sessions and notifies them if something changed"""
+        while True:
+            await asyncio.sleep(interval)
+            changed = False
+            for session_id in list(self.observers):
+                try:
+                    changed |= await self.poll_session(session_id)
+                except Exception:
+                    logging.exception(f"Exception occurred while polling updates of session {session_id:08x}")
+            if changed:
+                self.updated_state()
+
+
 async def heartbeat():
     """Periodically logs an INFO message every 15 minutes to confirm the server is running."""
     while True:
@@ -271,12 +596,17 @@ async def coap_server():
 
     root = resource.Site()
     root.add_resource(('.well-known/core',), resource.WKCResource(root.get_resources_as_linkheader))
-    root.add_resource(('message',), CoAPResource())
-    root.add_resource(('update',), CoAPResourceGet())
+    updates = CoAPResourceGet()
+    config = CoAPResourceConfig(updates)
+    root.add_resource(('message',), CoAPResource(updates))
+    root.add_resource(('update',), updates)
+    root.add_resource(('config',), config)
+    root.add_resource(('register',), CoAPResourceRegister())
 
     await asyncio.gather(
         aiocoap.Context.create_server_context(root, bind=(coap_server_ip, 5683)),
-        heartbeat()
+        heartbeat(),
+        config.poll(config_poll_interval)
     )
 
 